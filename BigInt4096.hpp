@@ -7,234 +7,1654 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <vector>
+#include <charconv>
+#include <cstring>
+#include <random>
+#include <memory>
+#include "WordKernels.hpp"
+#include "Deadline.hpp"
+#include "Stats.hpp"
+
+// What BigInt::isPrime() runs once trial division is done
+enum class PrimalityTest {
+    Auto,        // Deterministic bases below 3.3 * 10^24, Baillie-PSW above
+    BailliePSW,  // A strong base-2 round plus a strong Lucas test
+    FixedBases,  // Miller-Rabin to the first `rounds` primes
+    RandomBases, // Miller-Rabin to `rounds` random bases in [2, n - 2]
+};
+
+// -----------------------------------
+// BigInt<Bits>: fixed-width unsigned integer of Bits / 64 words. Every buffer and
+// width-bound loop is sized at compile time, so narrow instantiations keep small
+// objects and short loops; BigInt4096 is the widest one the tools use.
+// -----------------------------------
+template <size_t Bits>
+class BigInt {
+    static_assert(Bits % 64 == 0 && Bits >= 128, "BigInt is a whole number of words, at least two");
+    template <size_t> friend class BigInt;
 
-class BigInt4096 {
 private:
-    static constexpr size_t NUM_WORDS = 64;
+    static constexpr size_t NUM_WORDS = Bits / 64;
     std::array<uint64_t, NUM_WORDS> data{};
+    // Number of significant words: data[used - 1] != 0 and every word above it is zero
+    size_t used = 0;
 
 public:
-    // Constructors
-    BigInt4096() { data.fill(0); }
-    BigInt4096(uint64_t value) { data.fill(0); data[0] = value; }
-    BigInt4096(const std::string& decimal) {
-        data.fill(0);
-        BigInt4096 base(10);
+    static constexpr size_t BITS = Bits;
+
+    // Constructors. data{} already zeroes every word, so none of them clears it again;
+    // constexpr lets ZERO, ONE and TWO be initialized at compile time
+    constexpr BigInt() = default;
+    constexpr BigInt(uint64_t value) : data{{value}}, used(value != 0) {}
+    // From another width, keeping the low Bits bits
+    template <size_t OtherBits>
+    explicit BigInt(const BigInt<OtherBits>& other) {
+        size_t n = std::min({other.used, NUM_WORDS, BigInt<OtherBits>::NUM_WORDS});
+        std::copy(other.data.begin(), other.data.begin() + n, data.begin());
+        normalize(n);
+    }
+    // Non-digit characters are skipped; values past Bits bits wrap
+    BigInt(const std::string& decimal) {
+        // Up to 19 digits are gathered into one word, then folded in with a single-limb multiply-add
+        uint64_t chunk = 0;
+        size_t digits = 0;
         for (char c : decimal) {
             if (c < '0' || c > '9') continue;
-            *this *= base;
-            *this += BigInt4096(c - '0');
+            chunk = chunk * 10 + (c - '0');
+            if (++digits == CHUNK_DIGITS) {
+                mulAddSmall(POW10[CHUNK_DIGITS], chunk);
+                chunk = 0;
+                digits = 0;
+            }
         }
+        if (digits) mulAddSmall(POW10[digits], chunk);
     }
 
     // Arithmetic operators
-    BigInt4096 operator+(const BigInt4096& rhs) const {
-        BigInt4096 res;
+    BigInt operator+(const BigInt& rhs) const {
+        BigInt res;
+        size_t n = std::max(used, rhs.used);
         uint64_t carry = 0;
-        for (size_t i = 0; i < NUM_WORDS; ++i) {
+        for (size_t i = 0; i < n; ++i) {
             __uint128_t sum = (__uint128_t)data[i] + rhs.data[i] + carry;
             res.data[i] = (uint64_t)sum;
             carry = (uint64_t)(sum >> 64);
         }
+        if (n < NUM_WORDS) res.data[n] = carry;
+        res.normalize(n + 1);
         return res;
     }
-    BigInt4096& operator+=(const BigInt4096& rhs) { *this = *this + rhs; return *this; }
+    // In place: only the significant words are touched and no temporary is built
+    BigInt& operator+=(const BigInt& rhs) {
+        size_t n = std::max(used, rhs.used);
+        uint64_t carry = addWords(data.data(), n, rhs.data.data(), rhs.used);
+        if (carry && n < NUM_WORDS) data[n++] = carry;
+        normalize(n);
+        return *this;
+    }
+    BigInt& operator+=(uint64_t rhs) {
+        const uint64_t word[1] = {rhs};
+        size_t n = std::max<size_t>(used, 1);
+        uint64_t carry = addWords(data.data(), n, word, 1);
+        if (carry && n < NUM_WORDS) data[n++] = carry;
+        normalize(n);
+        return *this;
+    }
+    BigInt operator+(uint64_t rhs) const { BigInt res = *this; return res += rhs; }
+    BigInt& operator++() { return *this += 1; }
+    BigInt operator++(int) { BigInt old = *this; *this += 1; return old; }
 
-    BigInt4096 operator-(const BigInt4096& rhs) const {
-        BigInt4096 res;
+    BigInt operator-(const BigInt& rhs) const {
+        BigInt res;
+        size_t n = std::max(used, rhs.used);
         uint64_t borrow = 0;
-        for (size_t i = 0; i < NUM_WORDS; ++i) {
+        for (size_t i = 0; i < n; ++i) {
             __uint128_t sub = (__uint128_t)data[i] - rhs.data[i] - borrow;
             res.data[i] = (uint64_t)sub;
             borrow = (sub >> 127) & 1;
         }
+        if (borrow) n = res.wrapBelowZero(n);
+        res.normalize(n);
         return res;
     }
-    BigInt4096& operator-=(const BigInt4096& rhs) { *this = *this - rhs; return *this; }
+    BigInt& operator-=(const BigInt& rhs) {
+        size_t n = std::max(used, rhs.used);
+        if (subWords(data.data(), n, rhs.data.data(), rhs.used)) n = wrapBelowZero(n);
+        normalize(n);
+        return *this;
+    }
+    BigInt& operator-=(uint64_t rhs) {
+        const uint64_t word[1] = {rhs};
+        size_t n = std::max<size_t>(used, 1);
+        if (subWords(data.data(), n, word, 1)) n = wrapBelowZero(n);
+        normalize(n);
+        return *this;
+    }
+    BigInt operator-(uint64_t rhs) const { BigInt res = *this; return res -= rhs; }
+    BigInt& operator--() { return *this -= 1; }
+    BigInt operator--(int) { BigInt old = *this; *this -= 1; return old; }
 
-    BigInt4096 operator*(const BigInt4096& rhs) const {
-        BigInt4096 res;
-        for (size_t i = 0; i < NUM_WORDS; ++i) {
-            if (data[i] == 0) continue;
-            uint64_t carry = 0;
-            for (size_t j = 0; j + i < NUM_WORDS; ++j) {
-                __uint128_t mul = (__uint128_t)data[i] * rhs.data[j] + res.data[i + j] + carry;
-                res.data[i + j] = (uint64_t)mul;
-                carry = (uint64_t)(mul >> 64);
-            }
+    BigInt operator*(const BigInt& rhs) const {
+        BigInt res;
+        size_t lo = std::min(used, rhs.used), hi = std::max(used, rhs.used);
+        if (lo == 0) return res;
+        size_t cols = std::min(used + rhs.used, NUM_WORDS);
+        if (this == &rhs && 2 * used <= NUM_WORDS) {
+            // x * x: the squaring kernels form each cross product once
+            uint64_t full[2 * NUM_WORDS];
+            sqrBasecase(data.data(), used, full);
+            std::copy(full, full + cols, res.data.begin());
+        } else if (lo < KARATSUBA_THRESHOLD || 2 * lo <= hi) {
+            // Small or lopsided operands: one product-scanning pass over the needed columns
+            mulComba(data.data(), used, rhs.data.data(), rhs.used, res.data.data(), cols);
+        } else if (used + rhs.used <= NUM_WORDS) {
+            // Limbs above `used` are zero, so both operands can be read as hi-word values
+            uint64_t full[2 * NUM_WORDS];
+            mulKaratsuba(data.data(), rhs.data.data(), hi, full);
+            std::copy(full, full + cols, res.data.begin());
+        } else {
+            // The product overflows Bits bits: only the low NUM_WORDS words are kept
+            mulLow(data.data(), rhs.data.data(), NUM_WORDS, res.data.data());
         }
+        res.normalize(cols);
         return res;
     }
-    BigInt4096& operator*=(const BigInt4096& rhs) { *this = *this * rhs; return *this; }
+    BigInt& operator*=(const BigInt& rhs) { *this = *this * rhs; return *this; }
 
-    BigInt4096 operator/(const BigInt4096& rhs) const {
-        if (rhs == 0) throw std::runtime_error("Modulo by zero");
-        BigInt4096 dividend = *this;
-        BigInt4096 divisor = rhs, quotient, current;
-        for (int i = NUM_WORDS * 64 - 1; i >= 0; --i) {
-            current = current << 1;
-            current.data[0] |= (dividend.data[i / 64] >> (i % 64)) & 1;
-            if (current >= divisor) {
-                current -= divisor;
-                quotient.data[i / 64] |= (1ULL << (i % 64));
-            }
-        }
+    BigInt operator/(const BigInt& rhs) const {
+        BigInt quotient, remainder;
+        divmod(*this, rhs, quotient, remainder);
         return quotient;
     }
-    BigInt4096& operator/=(const BigInt4096& rhs) { *this = *this / rhs; return *this; }
+    BigInt& operator/=(const BigInt& rhs) { *this = *this / rhs; return *this; }
 
-    BigInt4096 operator%(const BigInt4096& rhs) const {
-        if (rhs == 0) throw std::runtime_error("Modulo by zero");
-        BigInt4096 dividend = *this;
-        BigInt4096 divisor = rhs, current;
-        for (int i = NUM_WORDS * 64 - 1; i >= 0; --i) {
-            current = current << 1;
-            current.data[0] |= (dividend.data[i / 64] >> (i % 64)) & 1;
-            if (current >= divisor)
-                current -= divisor;
-        }
-        return current;
+    BigInt operator%(const BigInt& rhs) const {
+        BigInt quotient, remainder;
+        divmod(*this, rhs, quotient, remainder);
+        return remainder;
     }
-    BigInt4096& operator%=(const BigInt4096& rhs) { *this = *this % rhs; return *this; }
+    BigInt& operator%=(const BigInt& rhs) { *this = *this % rhs; return *this; }
 
     // Bitwise
-    BigInt4096 operator&(const BigInt4096& rhs) const {
-        BigInt4096 res;
-        for (size_t i = 0; i < NUM_WORDS; ++i)
-            res.data[i] = data[i] & rhs.data[i];
+    BigInt operator&(const BigInt& rhs) const {
+        BigInt res;
+        size_t n = std::min(used, rhs.used);
+        if (n >= WordKernels::VECTOR_MIN_WORDS)
+            WordKernels::andWords(res.data.data(), data.data(), rhs.data.data(), n);
+        else
+            for (size_t i = 0; i < n; ++i)
+                res.data[i] = data[i] & rhs.data[i];
+        res.normalize(n);
         return res;
     }
-    BigInt4096 operator|(const BigInt4096& rhs) const {
-        BigInt4096 res;
-        for (size_t i = 0; i < NUM_WORDS; ++i)
-            res.data[i] = data[i] | rhs.data[i];
+    BigInt operator|(const BigInt& rhs) const {
+        BigInt res;
+        size_t n = std::max(used, rhs.used);
+        if (n >= WordKernels::VECTOR_MIN_WORDS)
+            WordKernels::orWords(res.data.data(), data.data(), rhs.data.data(), n);
+        else
+            for (size_t i = 0; i < n; ++i)
+                res.data[i] = data[i] | rhs.data[i];
+        res.used = n;
         return res;
     }
-    BigInt4096 operator^(const BigInt4096& rhs) const {
-        BigInt4096 res;
-        for (size_t i = 0; i < NUM_WORDS; ++i)
-            res.data[i] = data[i] ^ rhs.data[i];
+    BigInt operator^(const BigInt& rhs) const {
+        BigInt res;
+        size_t n = std::max(used, rhs.used);
+        if (n >= WordKernels::VECTOR_MIN_WORDS)
+            WordKernels::xorWords(res.data.data(), data.data(), rhs.data.data(), n);
+        else
+            for (size_t i = 0; i < n; ++i)
+                res.data[i] = data[i] ^ rhs.data[i];
+        res.normalize(n);
         return res;
     }
-    BigInt4096 operator~() const {
-        BigInt4096 res;
-        for (size_t i = 0; i < NUM_WORDS; ++i)
-            res.data[i] = ~data[i];
+    BigInt operator~() const {
+        BigInt res;
+        if (NUM_WORDS >= WordKernels::VECTOR_MIN_WORDS)
+            WordKernels::notWords(res.data.data(), data.data(), NUM_WORDS);
+        else
+            for (size_t i = 0; i < NUM_WORDS; ++i)
+                res.data[i] = ~data[i];
+        res.normalize(NUM_WORDS);
         return res;
     }
 
     // Shifts
-    BigInt4096 operator<<(size_t shift) const {
-        BigInt4096 res;
+    BigInt operator<<(size_t shift) const {
+        BigInt res;
         size_t wordShift = shift / 64;
         size_t bitShift = shift % 64;
-        for (int i = NUM_WORDS - 1; i >= 0; --i) {
-            if ((size_t)i < wordShift) continue;
+        size_t top = std::min(NUM_WORDS, used + wordShift + 1);
+        if (bitShift && top >= wordShift + WordKernels::VECTOR_MIN_WORDS) {
+            WordKernels::shiftLeft(res.data.data() + wordShift, data.data(), top - wordShift, (unsigned)bitShift);
+            res.normalize(top);
+            return res;
+        }
+        for (size_t i = wordShift; i < top; ++i) {
             uint64_t lower = data[i - wordShift] << bitShift;
             uint64_t upper = 0;
-            if (bitShift && i >= (int)(wordShift + 1))
+            if (bitShift && i >= wordShift + 1)
                 upper = data[i - wordShift - 1] >> (64 - bitShift);
             res.data[i] = lower | upper;
         }
+        res.normalize(top);
         return res;
     }
-    BigInt4096 operator>>(size_t shift) const {
-        BigInt4096 res;
+    BigInt operator>>(size_t shift) const {
+        BigInt res;
         size_t wordShift = shift / 64;
         size_t bitShift = shift % 64;
-        for (size_t i = 0; i < NUM_WORDS; ++i) {
-            if (i + wordShift >= NUM_WORDS) continue;
+        if (wordShift >= used) return res;
+        size_t top = used - wordShift;
+        if (bitShift && top >= WordKernels::VECTOR_MIN_WORDS) {
+            WordKernels::shiftRight(res.data.data(), data.data() + wordShift, top, (unsigned)bitShift);
+            res.normalize(top);
+            return res;
+        }
+        for (size_t i = 0; i < top; ++i) {
             uint64_t upper = data[i + wordShift] >> bitShift;
             uint64_t lower = 0;
             if (bitShift && i + wordShift + 1 < NUM_WORDS)
                 lower = data[i + wordShift + 1] << (64 - bitShift);
             res.data[i] = upper | lower;
         }
+        res.normalize(top);
         return res;
     }
+    BigInt& operator<<=(size_t shift) {
+        size_t wordShift = shift / 64;
+        size_t bitShift = shift % 64;
+        size_t top = std::min(NUM_WORDS, used + wordShift + 1);
+        // Top down, so every source word is read before it is overwritten
+        if (bitShift && top >= wordShift + WordKernels::VECTOR_MIN_WORDS) {
+            WordKernels::shiftLeft(data.data() + wordShift, data.data(), top - wordShift, (unsigned)bitShift);
+        } else {
+            for (size_t i = top; i-- > wordShift;) {
+                uint64_t lower = data[i - wordShift] << bitShift;
+                uint64_t upper = bitShift && i > wordShift ? data[i - wordShift - 1] >> (64 - bitShift) : 0;
+                data[i] = lower | upper;
+            }
+        }
+        std::fill(data.begin(), data.begin() + std::min(wordShift, top), 0);
+        normalize(top);
+        return *this;
+    }
+    BigInt& operator>>=(size_t shift) {
+        size_t wordShift = shift / 64;
+        size_t bitShift = shift % 64;
+        size_t top = wordShift < used ? used - wordShift : 0;
+        // Bottom up, for the same reason
+        if (bitShift && top >= WordKernels::VECTOR_MIN_WORDS) {
+            WordKernels::shiftRight(data.data(), data.data() + wordShift, top, (unsigned)bitShift);
+        } else {
+            for (size_t i = 0; i < top; ++i) {
+                uint64_t upper = data[i + wordShift] >> bitShift;
+                uint64_t lower = bitShift && i + wordShift + 1 < used ? data[i + wordShift + 1] << (64 - bitShift) : 0;
+                data[i] = upper | lower;
+            }
+        }
+        std::fill(data.begin() + top, data.begin() + used, 0);
+        normalize(top);
+        return *this;
+    }
 
     // Comparison
-    bool operator==(const BigInt4096& rhs) const { return data == rhs.data; }
-    bool operator!=(const BigInt4096& rhs) const { return !(*this == rhs); }
-    bool operator<(const BigInt4096& rhs) const {
-        for (int i = NUM_WORDS - 1; i >= 0; --i) {
+    bool operator==(const BigInt& rhs) const {
+        if (used != rhs.used) return false;
+        if (used >= WordKernels::VECTOR_MIN_WORDS)
+            return WordKernels::highestDifference(data.data(), rhs.data.data(), used) == used;
+        return std::equal(data.begin(), data.begin() + used, rhs.data.begin());
+    }
+    bool operator!=(const BigInt& rhs) const { return !(*this == rhs); }
+    bool operator<(const BigInt& rhs) const {
+        if (used != rhs.used) return used < rhs.used;
+        if (used >= WordKernels::VECTOR_MIN_WORDS) {
+            size_t i = WordKernels::highestDifference(data.data(), rhs.data.data(), used);
+            return i < used && data[i] < rhs.data[i];
+        }
+        for (int i = (int)used - 1; i >= 0; --i) {
             if (data[i] < rhs.data[i]) return true;
             if (data[i] > rhs.data[i]) return false;
         }
         return false;
     }
-    bool operator>(const BigInt4096& rhs) const { return rhs < *this; }
-    bool operator<=(const BigInt4096& rhs) const { return !(rhs < *this); }
-    bool operator>=(const BigInt4096& rhs) const { return !(*this < rhs); }
+    bool operator>(const BigInt& rhs) const { return rhs < *this; }
+    bool operator<=(const BigInt& rhs) const { return !(rhs < *this); }
+    bool operator>=(const BigInt& rhs) const { return !(*this < rhs); }
 
     // I/O
-    friend std::ostream& operator<<(std::ostream& os, const BigInt4096& bi) {
-        if (bi == BigInt4096(0)) return os << "0";
-        BigInt4096 temp = bi;
-        BigInt4096 zero(0), ten(10);
-        std::string out;
-        while (temp != zero) {
-            BigInt4096 digit = temp % ten;
-            out += '0' + digit.data[0];
-            temp /= ten;
-        }
-        std::reverse(out.begin(), out.end());
-        return os << out;
-    }
-    friend std::istream& operator>>(std::istream& is, BigInt4096& bi) {
+    // Decimal digits in 2^Bits - 1, from log10(2) = 0.30103 (exact for every width up to 4096)
+    static constexpr size_t MAX_DECIMAL_DIGITS = Bits * 30103 / 100000 + 1;
+
+    // Writes the decimal form into [first, last) without allocating, like std::to_chars
+    std::to_chars_result toChars(char* first, char* last) const {
+        char buf[MAX_DECIMAL_DIGITS];
+        char* end = buf + MAX_DECIMAL_DIGITS;
+        char* begin = used ? writeDigits(*this, end, 0) : end - 1;
+        if (!used) *begin = '0';
+        size_t len = end - begin;
+        if ((size_t)(last - first) < len) return {last, std::errc::value_too_large};
+        std::memcpy(first, begin, len);
+        return {first + len, std::errc()};
+    }
+
+    // Static: toChars() of the value in words[0, n), least significant first, without building
+    // a BigInt. Up to DECIMAL_SPLIT_WORDS words are divided down in a copy of just those words.
+    static std::to_chars_result toChars(const uint64_t* words, size_t n, char* first, char* last) {
+        while (n && !words[n - 1]) --n;
+        if (n <= 1) return std::to_chars(first, last, n ? words[0] : 0);
+        if (n > std::min(DECIMAL_SPLIT_WORDS, NUM_WORDS)) return fromWords(words, n).toChars(first, last);
+        uint64_t w[DECIMAL_SPLIT_WORDS];
+        std::copy(words, words + n, w);
+        char buf[DECIMAL_SPLIT_WORDS * 64 * 30103 / 100000 + 1];
+        char* end = buf + sizeof buf;
+        char* p = end;
+        while (n) {
+            uint64_t chunk = 0;
+            for (size_t i = n; i-- > 0;) {
+                __uint128_t num = ((__uint128_t)chunk << 64) | w[i];
+                w[i] = (uint64_t)(num / POW10[CHUNK_DIGITS]);
+                chunk = (uint64_t)(num % POW10[CHUNK_DIGITS]);
+            }
+            while (n && !w[n - 1]) --n;
+            for (size_t i = 0; i < CHUNK_DIGITS && (chunk || n); ++i) {
+                *--p = '0' + chunk % 10;
+                chunk /= 10;
+            }
+        }
+        size_t len = end - p;
+        if ((size_t)(last - first) < len) return {last, std::errc::value_too_large};
+        std::memcpy(first, p, len);
+        return {first + len, std::errc()};
+    }
+
+    // Parses the longest run of decimal digits at first, like std::from_chars.
+    // Values above 2^Bits - 1 report result_out_of_range and leave value untouched.
+    static std::from_chars_result fromChars(const char* first, const char* last, BigInt& value) {
+        const char* end = first;
+        while (end != last && *end >= '0' && *end <= '9') ++end;
+        if (end == first) return {first, std::errc::invalid_argument};
+        const char* start = first;
+        while (start + 1 < end && *start == '0') ++start;
+        size_t len = end - start;
+        if (len > MAX_DECIMAL_DIGITS) return {end, std::errc::result_out_of_range};
+        if (len == MAX_DECIMAL_DIGITS) {
+            char max[MAX_DECIMAL_DIGITS];
+            (~ZERO).toChars(max, max + MAX_DECIMAL_DIGITS);
+            if (std::memcmp(start, max, len) > 0) return {end, std::errc::result_out_of_range};
+        }
+        value = readDigits(start, len);
+        return {end, std::errc()};
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const BigInt& bi) {
+        char buf[MAX_DECIMAL_DIGITS];
+        auto res = bi.toChars(buf, buf + MAX_DECIMAL_DIGITS);
+        return os.write(buf, res.ptr - buf);
+    }
+    friend std::istream& operator>>(std::istream& is, BigInt& bi) {
         std::string str;
         is >> str;
-        bi = BigInt4096(str);
+        bi = BigInt(str);
         return is;
     }
 
     // Cast
-    explicit operator bool() const {
-        for (auto w : data) if (w != 0) return true;
-        return false;
+    explicit operator bool() const { return used != 0; }
+    explicit operator uint64_t() const { return data[0]; }
+
+    size_t bitLength() const { return used ? used * 64 - __builtin_clzll(data[used - 1]) : 0; }
+
+    // The significant words, least significant first: the value without its zero padding
+    size_t wordCount() const { return used; }
+    const uint64_t* words() const { return data.data(); }
+    // From such words; any past NUM_WORDS are dropped
+    static BigInt fromWords(const uint64_t* words, size_t n) {
+        BigInt res;
+        n = std::min(n, NUM_WORDS);
+        std::copy(words, words + n, res.data.begin());
+        res.normalize(n);
+        return res;
+    }
+
+    // Static: quotient and remainder in one word-level long division (Knuth, TAOCP 4.3.1 D)
+    static void divmod(const BigInt& a, const BigInt& b, BigInt& quotient, BigInt& remainder) {
+        if (!b.used) throw std::runtime_error("Division by zero");
+        if (a < b) {
+            remainder = a;
+            quotient = BigInt();
+            return;
+        }
+        // quotient and remainder may alias a or b, so results are built in q and r
+        BigInt q, r;
+        size_t n = b.used, m = a.used - n;
+        if (n == 1) {
+            uint64_t d = b.data[0], rem = 0;
+            for (size_t i = a.used; i-- > 0;) {
+                __uint128_t num = ((__uint128_t)rem << 64) | a.data[i];
+                q.data[i] = (uint64_t)(num / d);
+                rem = (uint64_t)(num % d);
+            }
+            q.normalize(a.used);
+            quotient = q;
+            remainder = BigInt(rem);
+            return;
+        }
+        // Normalize so the divisor's top bit is set; quotient digit estimates are then off by at most 2
+        int s = __builtin_clzll(b.data[n - 1]);
+        uint64_t vn[NUM_WORDS], un[NUM_WORDS + 1];
+        for (size_t i = n - 1; i > 0; --i)
+            vn[i] = (b.data[i] << s) | (s ? b.data[i - 1] >> (64 - s) : 0);
+        vn[0] = b.data[0] << s;
+        un[a.used] = s ? a.data[a.used - 1] >> (64 - s) : 0;
+        for (size_t i = a.used - 1; i > 0; --i)
+            un[i] = (a.data[i] << s) | (s ? a.data[i - 1] >> (64 - s) : 0);
+        un[0] = a.data[0] << s;
+
+        for (size_t j = m + 1; j-- > 0;) {
+            __uint128_t num = ((__uint128_t)un[j + n] << 64) | un[j + n - 1];
+            __uint128_t qhat = num / vn[n - 1];
+            __uint128_t rhat = num % vn[n - 1];
+            while ((qhat >> 64) || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2])) {
+                --qhat;
+                rhat += vn[n - 1];
+                if (rhat >> 64) break;
+            }
+            // un[j, j + n] -= qhat * vn
+            uint64_t k = 0;
+            __int128 t;
+            for (size_t i = 0; i < n; ++i) {
+                __uint128_t p = qhat * vn[i];
+                t = (__int128)un[i + j] - k - (uint64_t)p;
+                un[i + j] = (uint64_t)t;
+                k = (uint64_t)(p >> 64) - (uint64_t)(t >> 64);
+            }
+            t = (__int128)un[j + n] - k;
+            un[j + n] = (uint64_t)t;
+            q.data[j] = (uint64_t)qhat;
+            if (t < 0) {
+                // qhat was one too large: add the divisor back
+                --q.data[j];
+                un[j + n] += addWords(un + j, n, vn, n);
+            }
+        }
+        q.normalize(m + 1);
+        for (size_t i = 0; i < n; ++i)
+            r.data[i] = (un[i] >> s) | (s ? un[i + 1] << (64 - s) : 0);
+        r.normalize(n);
+        quotient = q;
+        remainder = r;
+    }
+
+    // Remainder by a single word, one 128/64 division per significant limb
+    uint64_t modSmall(uint64_t m) const {
+        if (m == 0) throw std::runtime_error("Modulo by zero");
+        uint64_t rem = 0;
+        for (size_t i = used; i-- > 0;)
+            rem = (uint64_t)((((__uint128_t)rem << 64) | data[i]) % m);
+        return rem;
     }
 
+    // Montgomery-form modular arithmetic for a fixed odd modulus
+    class Montgomery;
+
     // Static: Modular exponentiation
-    static BigInt4096 modExp(BigInt4096 base, BigInt4096 exp, const BigInt4096& mod) {
-        if (mod == BigInt4096(0)) throw std::runtime_error("modulo by zero");
-        BigInt4096 result(1);
-        base %= mod;
-        while (exp != BigInt4096(0)) {
-            if (exp.data[0] & 1) result = (result * base) % mod;
-            exp = exp >> 1;
-            base = (base * base) % mod;
+    static BigInt modExp(BigInt base, BigInt exp, const BigInt& mod);
+
+    // Static: a * b mod m, safe when the product would not fit in Bits bits
+    static BigInt modMul(const BigInt& a, const BigInt& b, const BigInt& mod);
+
+    // Static: a^2 mod m through the squaring kernels
+    static BigInt modSqr(const BigInt& a, const BigInt& mod);
+
+    // Number of small primes isPrime() trial-divides by before Miller-Rabin
+    static constexpr size_t TRIAL_PRIMES = 2048;
+
+    // Static: trial division by the first `count` primes (at most TRIAL_PRIMES);
+    // returns true when n has one of them as a proper factor
+    static bool hasSmallFactor(const BigInt& n, size_t count = TRIAL_PRIMES);
+
+    // Shared by every width
+    using PrimalityTest = ::PrimalityTest;
+
+    // Static: primality test; `rounds` applies to FixedBases and RandomBases only
+    static bool isPrime(const BigInt& n, PrimalityTest test = PrimalityTest::Auto, int rounds = 5,
+                        size_t trialPrimes = TRIAL_PRIMES);
+
+    // A backend for the bulk base-2 round: passed[i] = isStrongProbablePrime(n[i], 2) for
+    // count odd n[i] > 2
+    using Base2Batch = void (*)(const BigInt* n, size_t count, bool* passed);
+
+    // Static: isPrime() of every candidate. Trial-division survivors go through the base-2
+    // round every test starts with as one batch, by default BATCH_LANES at a time in lockstep,
+    // so composites cost a fraction of an exponentiation each; the candidates that pass finish
+    // the test one by one. RandomBases gets the base-2 round up front, which can only reject
+    // composites.
+    static std::vector<bool> isPrimeBatch(const std::vector<BigInt>& candidates,
+                                          PrimalityTest test = PrimalityTest::Auto, int rounds = 5,
+                                          size_t trialPrimes = TRIAL_PRIMES,
+                                          Base2Batch base2 = isStrongProbablePrimeBatch);
+
+    // Static: one Miller-Rabin round, true when odd n > 2 is a strong probable prime to base.
+    // Bases at or above n are skipped (reported as passing), as isPrime() does.
+    static bool isStrongProbablePrime(const BigInt& n, uint64_t base);
+
+    // Candidates the batched rounds run side by side
+    static constexpr size_t BATCH_LANES = WordKernels::LANES;
+
+    // Static: isStrongProbablePrime(n[i], 2) into passed[i] for count odd n[i] > 2. With
+    // AVX-512 IFMA the candidates go BATCH_LANES at a time, one per vector lane.
+    static void isStrongProbablePrimeBatch(const BigInt* n, size_t count, bool* passed);
+
+    // Static: strong Lucas test with Selfridge's parameters (P = 1, D the first of
+    // 5, -7, 9, ... with Jacobi symbol (D/n) = -1), for odd n > 2
+    static bool isStrongLucasProbablePrime(const BigInt& n);
+
+    // Static: how many of the first primes make Miller-Rabin exact for n
+    // (Jaeschke; Sorenson and Webster), or 0 when n is 3.3 * 10^24 or more
+    static size_t deterministicBases(const BigInt& n);
+
+    // Static: the i-th prime counting from 2 = smallPrime(0), for i <= TRIAL_PRIMES
+    static uint64_t smallPrime(size_t i) { return i == 0 ? 2 : trialTable().primes[i - 1]; }
+
+    // Shared constants, so comparisons and loops need not build a temporary for them
+    static const BigInt ZERO, ONE, TWO;
+
+private:
+    size_t usedWords() const { return used; }
+
+    // After a borrow out of word n - 1: the words above it become all ones, as the
+    // borrow runs through them. Returns the new significant-word bound.
+    size_t wrapBelowZero(size_t n) {
+        std::fill(data.begin() + n, data.end(), ~0ULL);
+        return NUM_WORDS;
+    }
+
+    // Recompute the significant-word count after writing data[0, hint) directly
+    void normalize(size_t hint) {
+        used = std::min(hint, NUM_WORDS);
+        while (used > 0 && data[used - 1] == 0) --used;
+    }
+
+    // Decimal conversion works in base 10^19, the largest power of ten below 2^64
+    static constexpr size_t CHUNK_DIGITS = 19;
+    static constexpr uint64_t POW10[CHUNK_DIGITS + 1] = {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+        100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL};
+    // Above this many words, conversion splits the value at 10^(19 * 2^k) and recurses
+    static constexpr size_t DECIMAL_SPLIT_WORDS = 16;
+
+    // 10^(19 * 2^k) for k = 0, 1, ...: the split points for divide-and-conquer conversion
+    static const std::vector<BigInt>& decimalSplits() {
+        static const std::vector<BigInt> splits = [] {
+            std::vector<BigInt> out{BigInt(POW10[CHUNK_DIGITS])};
+            while (2 * out.back().used <= NUM_WORDS) out.push_back(out.back() * out.back());
+            return out;
+        }();
+        return splits;
+    }
+
+    // *this = *this * m + add, truncated to Bits bits
+    void mulAddSmall(uint64_t m, uint64_t add) {
+        uint64_t carry = add;
+        for (size_t i = 0; i < used; ++i) {
+            __uint128_t t = (__uint128_t)data[i] * m + carry;
+            data[i] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
         }
-        return result;
+        if (carry && used < NUM_WORDS) data[used++] = carry;
+        normalize(used);
+    }
+
+    // *this /= d, returning the remainder
+    uint64_t divSmall(uint64_t d) {
+        uint64_t rem = 0;
+        for (size_t i = used; i-- > 0;) {
+            __uint128_t num = ((__uint128_t)rem << 64) | data[i];
+            data[i] = (uint64_t)(num / d);
+            rem = (uint64_t)(num % d);
+        }
+        normalize(used);
+        return rem;
+    }
+
+    // Writes x right-aligned so it ends at `end`, zero-padded to at least `width` digits,
+    // and returns the first digit written
+    static char* writeDigits(const BigInt& x, char* end, size_t width) {
+        char* p = end;
+        if (x.used > DECIMAL_SPLIT_WORDS) {
+            // x = hi * 10^d + lo with the split nearest half of x's width
+            const auto& splits = decimalSplits();
+            size_t k = 0;
+            while (k + 1 < splits.size() && 2 * splits[k + 1].used <= x.used + 1) ++k;
+            size_t d = CHUNK_DIGITS << k;
+            BigInt hi, lo;
+            divmod(x, splits[k], hi, lo);
+            if (!hi.used) return writeDigits(lo, end, width);
+            p = writeDigits(lo, end, d);
+            p = writeDigits(hi, p, width > d ? width - d : 0);
+            return p;
+        }
+        BigInt temp = x;
+        while (temp.used) {
+            uint64_t chunk = temp.divSmall(POW10[CHUNK_DIGITS]);
+            // Inner chunks keep their leading zeros, the top one does not
+            for (size_t i = 0; i < CHUNK_DIGITS && (chunk || temp.used); ++i) {
+                *--p = '0' + chunk % 10;
+                chunk /= 10;
+            }
+        }
+        while ((size_t)(end - p) < width) *--p = '0';
+        return p;
+    }
+
+    // Value of the `len` decimal digits at s, which must fit in Bits bits
+    static BigInt readDigits(const char* s, size_t len) {
+        if (len > DECIMAL_SPLIT_WORDS * CHUNK_DIGITS) {
+            // Split off the low 19 * 2^k digits, the largest such block no longer than the rest
+            const auto& splits = decimalSplits();
+            size_t k = 0;
+            while (k + 1 < splits.size() && 2 * (CHUNK_DIGITS << (k + 1)) <= len) ++k;
+            size_t d = CHUNK_DIGITS << k;
+            return readDigits(s, len - d) * splits[k] + readDigits(s + len - d, d);
+        }
+        BigInt res;
+        size_t take = len % CHUNK_DIGITS ? len % CHUNK_DIGITS : CHUNK_DIGITS;
+        for (size_t i = 0; i < len; i += take, take = CHUNK_DIGITS) {
+            uint64_t chunk = 0;
+            for (size_t j = 0; j < take; ++j) chunk = chunk * 10 + (s[i + j] - '0');
+            res.mulAddSmall(POW10[take], chunk);
+        }
+        return res;
+    }
+
+    // Operand width (in words) from which Karatsuba beats product scanning
+    static constexpr size_t KARATSUBA_THRESHOLD = 24;
+
+    // Columns [0, cols) of a * b, column by column with a three-word accumulator (Comba)
+    static void mulComba(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, uint64_t* out, size_t cols) {
+        __uint128_t acc = 0;
+        uint64_t top = 0;
+        for (size_t k = 0; k < cols; ++k) {
+            size_t i = k + 1 > nb ? k + 1 - nb : 0;
+            size_t end = std::min(k + 1, na);
+            for (; i < end; ++i) {
+                __uint128_t prod = (__uint128_t)a[i] * b[k - i];
+                acc += prod;
+                top += acc < prod;
+            }
+            out[k] = (uint64_t)acc;
+            acc = (acc >> 64) | ((__uint128_t)top << 64);
+            top = 0;
+        }
+    }
+
+    // r[0, rn) += a[0, an), returning the carry out of the top word
+    static uint64_t addWords(uint64_t* r, size_t rn, const uint64_t* a, size_t an) {
+        uint64_t carry = 0;
+        size_t i = 0;
+        for (; i < an; ++i) {
+            __uint128_t sum = (__uint128_t)r[i] + a[i] + carry;
+            r[i] = (uint64_t)sum;
+            carry = (uint64_t)(sum >> 64);
+        }
+        for (; carry && i < rn; ++i) carry = ++r[i] == 0;
+        return carry;
+    }
+
+    // r[0, rn) -= a[0, an), returning the borrow out of the top word
+    static uint64_t subWords(uint64_t* r, size_t rn, const uint64_t* a, size_t an) {
+        uint64_t borrow = 0;
+        size_t i = 0;
+        for (; i < an; ++i) {
+            __uint128_t sub = (__uint128_t)r[i] - a[i] - borrow;
+            r[i] = (uint64_t)sub;
+            borrow = (sub >> 127) & 1;
+        }
+        for (; borrow && i < rn; ++i) borrow = r[i]-- == 0;
+        return borrow;
+    }
+
+    // out = |a - b| over n words; returns true when a < b
+    static bool absDiff(const uint64_t* a, const uint64_t* b, size_t n, uint64_t* out) {
+        size_t i = n;
+        while (i > 0 && a[i - 1] == b[i - 1]) --i;
+        bool less = i > 0 && a[i - 1] < b[i - 1];
+        if (less) std::swap(a, b);
+        std::copy(a, a + n, out);
+        subWords(out, n, b, n);
+        return less;
+    }
+
+    // out[0, 2n) = a * b for n-word operands. Subtractive Karatsuba:
+    // a0*b1 + a1*b0 = a0*b0 + a1*b1 + (a0 - a1)(b1 - b0)
+    static void mulKaratsuba(const uint64_t* a, const uint64_t* b, size_t n, uint64_t* out) {
+        if (n < KARATSUBA_THRESHOLD) {
+            mulComba(a, n, b, n, out, 2 * n);
+            return;
+        }
+        size_t h = (n + 1) / 2, l = n - h;
+        // Upper halves padded to h words
+        uint64_t a1[NUM_WORDS] = {}, b1[NUM_WORDS] = {};
+        std::copy(a + h, a + n, a1);
+        std::copy(b + h, b + n, b1);
+        mulKaratsuba(a, b, h, out);
+        mulKaratsuba(a1, b1, l, out + 2 * h);
+        uint64_t da[NUM_WORDS], db[NUM_WORDS], mid[2 * NUM_WORDS];
+        bool negative = absDiff(a, a1, h, da) != absDiff(b1, b, h, db);
+        mulKaratsuba(da, db, h, mid);
+        // middle = z0 + z2 -/+ |a0 - a1| * |b1 - b0|, at most 2h + 1 words
+        uint64_t middle[2 * NUM_WORDS + 1] = {};
+        std::copy(out, out + 2 * h, middle);
+        addWords(middle, 2 * h + 1, out + 2 * h, 2 * l);
+        if (negative)
+            subWords(middle, 2 * h + 1, mid, 2 * h);
+        else
+            addWords(middle, 2 * h + 1, mid, 2 * h);
+        addWords(out + h, 2 * n - h, middle, 2 * h + 1);
+    }
+
+    // out[0, 2n) = a^2 column by column, like mulComba, but each cross product a[i] * a[j]
+    // (i < j) is formed once and doubled, and only the squares sit on the diagonal
+    static void sqrBasecase(const uint64_t* a, size_t n, uint64_t* out) {
+        __uint128_t acc = 0;
+        uint64_t top = 0;
+        for (size_t k = 0; k + 1 < 2 * n; ++k) {
+            size_t i = k + 1 > n ? k + 1 - n : 0, j = k - i;
+            __uint128_t cross = 0;
+            uint64_t crossTop = 0;
+            for (; i < j; ++i, --j) {
+                __uint128_t prod = (__uint128_t)a[i] * a[j];
+                cross += prod;
+                crossTop += cross < prod;
+            }
+            crossTop = crossTop << 1 | (uint64_t)(cross >> 127);
+            cross <<= 1;
+            if (i == j) {
+                __uint128_t prod = (__uint128_t)a[i] * a[i];
+                cross += prod;
+                crossTop += cross < prod;
+            }
+            acc += cross;
+            top += crossTop + (acc < cross);
+            out[k] = (uint64_t)acc;
+            acc = (acc >> 64) | ((__uint128_t)top << 64);
+            top = 0;
+        }
+        out[2 * n - 1] = (uint64_t)acc;
+    }
+
+    // GCC cannot follow the recursion that fills cross and flags it at -O3
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    // out[0, n) = a * b mod 2^(64n): the low half only, for truncated products and REDC
+    static void mulLow(const uint64_t* a, const uint64_t* b, size_t n, uint64_t* out) {
+        if (n < KARATSUBA_THRESHOLD) {
+            mulComba(a, n, b, n, out, n);
+            return;
+        }
+        // low(a * b) = a0*b0 + (low(a0*b1) + low(a1*b0)) * 2^(64h)
+        size_t h = (n + 1) / 2, l = n - h;
+        uint64_t full[2 * NUM_WORDS], cross[NUM_WORDS];
+        mulKaratsuba(a, b, h, full);
+        std::copy(full, full + n, out);
+        mulLow(a, b + h, l, cross);
+        addWords(out + h, l, cross, l);
+        mulLow(a + h, b, l, cross);
+        addWords(out + h, l, cross, l);
     }
+#pragma GCC diagnostic pop
+
+    // Miller-Rabin round to base a for n = d * 2^r + 1 in the context mont
+    static bool strongRound(const Montgomery& mont, const BigInt& d, int r, const BigInt& a);
+
+    // isPrime() up to the first exponentiation: 1 for prime, 0 for composite, -1 when undecided
+    static int screen(const BigInt& n, size_t trialPrimes);
+
+    // n - 1 = d * 2^r: r is the run of low zero bits of n - 1
+    static int splitPowerOfTwo(const BigInt& n, BigInt& d);
+
+    // What `test` runs after a passed base-2 round
+    static bool laterRounds(const Montgomery& mont, const BigInt& d, int r, PrimalityTest test, int rounds);
 
-    // Static: Miller-Rabin primality test
-    static bool isPrime(const BigInt4096& n, int rounds = 5) {
-        if (n <= BigInt4096(1)) return false;
-        if (n == BigInt4096(2) || n == BigInt4096(3)) return true;
-        if ((n.data[0] & 1) == 0) return false;
-        BigInt4096 d = n - BigInt4096(1);
-        int r = 0;
-        while ((d.data[0] & 1) == 0) {
-            d = d >> 1;
-            ++r;
-        }
-        const int basePrimes[5] = {2, 3, 5, 7, 11};
-        for (int i = 0; i < rounds; ++i) {
-            BigInt4096 a(basePrimes[i]);
-            BigInt4096 x = modExp(a, d, n);
-            if (x == BigInt4096(1) || x == n - BigInt4096(1)) continue;
-            bool passed = false;
-            for (int j = 1; j < r; ++j) {
-                x = modExp(x, BigInt4096(2), n);
-                if (x == n - BigInt4096(1)) {
-                    passed = true;
-                    break;
+    // isStrongProbablePrimeBatch() for exactly BATCH_LANES candidates on the IFMA lanes
+    static void strongBase2Lanes(const BigInt* n, bool* passed);
+
+    // Uniform in [2, n - 2] for n > 4
+    static BigInt randomBase(const BigInt& n);
+
+    // Jacobi symbol (d / n) for odd n > 0
+    static int jacobi(int64_t d, const BigInt& n);
+
+    static bool isPerfectSquare(const BigInt& n);
+
+    // The first TRIAL_PRIMES odd primes, packed into runs whose product fits in one word
+    // so a single modSmall() serves every prime in the run
+    struct TrialTable {
+        struct Group {
+            uint64_t product;
+            size_t begin, end;
+        };
+        std::vector<uint32_t> primes;
+        std::vector<Group> groups;
+
+        TrialTable() {
+            for (uint32_t c = 3; primes.size() < TRIAL_PRIMES; c += 2) {
+                bool prime = true;
+                for (uint32_t p : primes) {
+                    if (p * p > c) break;
+                    if (c % p == 0) { prime = false; break; }
                 }
+                if (prime) primes.push_back(c);
+            }
+            for (size_t i = 0; i < primes.size();) {
+                Group g{primes[i], i, i + 1};
+                while (g.end < primes.size() && (__uint128_t)g.product * primes[g.end] <= UINT64_MAX)
+                    g.product *= primes[g.end++];
+                groups.push_back(g);
+                i = g.end;
             }
-            if (!passed) return false;
         }
-        return true;
+    };
+    static const TrialTable& trialTable() {
+        static const TrialTable table;
+        return table;
+    }
+};
+
+// -----------------------------------
+// Montgomery: precomputed context for a fixed odd modulus n of k words.
+// Values are kept as a*R mod n with R = 2^(64k); mul() is one interleaved
+// multiply and REDC pass (CIOS) instead of a bit-serial operator%. On CPUs
+// with AVX-512 IFMA, moduli of IFMA_MIN_WORDS words or more switch to m
+// digits of 52 bits and R = 2^(52m), multiplying eight digits per instruction;
+// only the products see the digits, so callers see the same interface.
+// The exponentiations poll Deadline::interrupted() every pollStride() squarings;
+// one cut short returns 0, which no strong round mistakes for +-1.
+// -----------------------------------
+template <size_t Bits>
+class BigInt<Bits>::Montgomery {
+public:
+    explicit Montgomery(const BigInt& mod) : n(mod), k(mod.usedWords()) {
+        if ((n.data[0] & 1) == 0) throw std::runtime_error("Montgomery modulus must be odd");
+        // nInv = -n^-1 mod 2^64 by Newton iteration (each step doubles the correct bits)
+        uint64_t inv = n.data[0];
+        for (int i = 0; i < 5; ++i) inv *= 2 - n.data[0] * inv;
+        nInv = ~inv + 1;
+        if (k >= REDC_KARATSUBA_WORDS) {
+            // Full-width n' = -n^-1 mod R, lifting the one-word inverse by Newton steps
+            // x <- x * (2 - n * x), each of which doubles the number of correct words
+            uint64_t x[NUM_WORDS] = {inv}, t[NUM_WORDS], next[NUM_WORDS];
+            const uint64_t two[1] = {2};
+            for (size_t words = 1; words < k; words *= 2) {
+                mulLow(n.data.data(), x, k, t);
+                negate(t);
+                addWords(t, k, two, 1);
+                mulLow(x, t, k, next);
+                std::copy(next, next + k, x);
+            }
+            std::copy(x, x + k, nPrime.begin());
+            negate(nPrime.data());
+        }
+        if (k >= IFMA_MIN_WORDS && WordKernels::hasIfma()) {
+            m52 = (n.bitLength() + 51) / 52;
+            toDigits(n, n52.data());
+            k52 = nInv & DIGIT_MASK;
+        }
+        size_t rBits = m52 ? 52 * m52 : 64 * k;
+        // R mod n and R^2 mod n by modular doubling, carrying out of the top word
+        BigInt x(1);
+        for (size_t i = 0; i < 2 * rBits; ++i) {
+            bool carry = x.data[NUM_WORDS - 1] >> 63;
+            x <<= 1;
+            if (carry || x >= n) x -= n;
+            if (i + 1 == rBits) rModN = x;
+        }
+        r2 = x;
+    }
+
+    const BigInt& modulus() const { return n; }
+    const BigInt& one() const { return rModN; }
+
+    // Squarings between deadline polls, so a poll costs about the same share of the work
+    // at every width
+    size_t pollStride() const { return std::max<uint64_t>(1, Deadline::POLL_WORK / (k * k)); }
+
+    BigInt toMont(const BigInt& a) const { return mul(a < n ? a : a % n, r2); }
+    BigInt fromMont(const BigInt& a) const { return mul(a, ONE); }
+
+    // a * b * R^-1 mod n, for a, b < n
+    BigInt mul(const BigInt& a, const BigInt& b) const {
+        if (m52) return mulIfma(a, b);
+        return k >= REDC_KARATSUBA_WORDS ? mulSeparated(a, b) : mulInterleaved(a, b);
+    }
+
+    // a^2 * R^-1 mod n, for a < n. The square costs about half a product, so the
+    // separate square-then-reduce beats the interleaved loop at every width.
+    BigInt sqr(const BigInt& a) const {
+        if (m52) return mulIfma(a, a);
+        uint64_t t[2 * NUM_WORDS + 1];
+        sqrBasecase(a.data.data(), k, t);
+        if (k >= REDC_KARATSUBA_WORDS) {
+            t[2 * k] = 0;
+            return redcSeparated(t);
+        }
+        // Word-by-word REDC: clear t[i] by adding m * n * 2^(64i); each row's carry lands in
+        // t[i + k], and what overflows that word rides along to the next row
+        uint64_t overflow = 0;
+        for (size_t i = 0; i < k; ++i) {
+            uint64_t m = t[i] * nInv, carry = 0;
+            for (size_t j = 0; j < k; ++j) {
+                __uint128_t sum = (__uint128_t)m * n.data[j] + t[i + j] + carry;
+                t[i + j] = (uint64_t)sum;
+                carry = (uint64_t)(sum >> 64);
+            }
+            __uint128_t sum = (__uint128_t)t[i + k] + carry + overflow;
+            t[i + k] = (uint64_t)sum;
+            overflow = (uint64_t)(sum >> 64);
+        }
+        return reduceOnce(t + k, overflow);
+    }
+
+    // base^exp mod n, returned in normal (non-Montgomery) form
+    BigInt exp(const BigInt& base, const BigInt& exp) const {
+        return fromMont(expMont(toMont(base), exp));
+    }
+
+    // Exponentiation entirely in the Montgomery domain: left-to-right sliding window over
+    // a table of odd powers, with the window widened as the exponent grows
+    BigInt expMont(const BigInt& base, const BigInt& exp) const {
+        size_t bits = exp.bitLength();
+        if (bits == 0) return rModN;
+        int w = bits <= 24 ? 1 : bits <= 96 ? 3 : bits <= 512 ? 4 : bits <= 1536 ? 5 : 6;
+        // table[i] = base^(2i + 1)
+        BigInt table[1 << 5];
+        table[0] = base;
+        // Products and squarings, for Stats
+        uint64_t muls = 0, sqrs = 0;
+        if (w > 1) {
+            BigInt square = sqr(base);
+            for (size_t i = 1; i < (size_t(1) << (w - 1)); ++i) table[i] = mul(table[i - 1], square);
+            muls += (size_t(1) << (w - 1)) - 1;
+            ++sqrs;
+        }
+        auto bit = [&](size_t i) { return (exp.data[i / 64] >> (i % 64)) & 1; };
+        BigInt result;
+        bool started = false;
+        size_t stride = pollStride(), steps = 0;
+        for (size_t i = bits; i-- > 0;) {
+            if (++steps % stride == 0 && Deadline::interrupted()) return ZERO;
+            if (!bit(i)) {
+                result = sqr(result);
+                ++sqrs;
+                continue;
+            }
+            // Longest window from bit i down that ends in a set bit
+            size_t j = i + 1 >= (size_t)w ? i + 1 - w : 0;
+            while (!bit(j)) ++j;
+            uint64_t value = 0;
+            for (size_t b = i + 1; b-- > j;) value = value << 1 | bit(b);
+            if (started) {
+                for (size_t s = j; s <= i; ++s) result = sqr(result);
+                result = mul(result, table[value >> 1]);
+                sqrs += i - j + 1;
+                ++muls;
+            } else {
+                result = table[value >> 1];
+                started = true;
+            }
+            i = j;
+        }
+        Stats::add(Stats::ModExp);
+        Stats::add(Stats::ModMul, muls);
+        Stats::add(Stats::ModSqr, sqrs);
+        return result;
+    }
+
+    // Bases up to this size use expMontSmall
+    static constexpr uint64_t SMALL_BASE_MAX = 64;
+
+    // a^exp in Montgomery form for a small base a < n (the Miller-Rabin witnesses).
+    // Left-to-right binary where each multiply by the base is a one-word multiply
+    // plus at most a - 1 subtractions (a doubling and at most one for base 2)
+    // instead of a Montgomery product.
+    BigInt expMontSmall(uint64_t a, const BigInt& exp) const {
+        size_t bits = exp.bitLength();
+        Stats::add(Stats::ModExp);
+        Stats::add(Stats::ModSqr, bits);
+        BigInt result = rModN;
+        size_t stride = pollStride();
+        for (size_t i = bits; i-- > 0;) {
+            if ((bits - i) % stride == 0 && Deadline::interrupted()) return ZERO;
+            result = sqr(result);
+            if ((exp.data[i / 64] >> (i % 64)) & 1) result = mulSmall(result, a);
+        }
+        return result;
+    }
+
+    // x * a mod n for x < n and a <= SMALL_BASE_MAX
+    BigInt mulSmall(const BigInt& x, uint64_t a) const {
+        uint64_t t[NUM_WORDS + 1];
+        uint64_t carry = 0;
+        for (size_t j = 0; j < k; ++j) {
+            __uint128_t p = (__uint128_t)x.data[j] * a + carry;
+            t[j] = (uint64_t)p;
+            carry = (uint64_t)(p >> 64);
+        }
+        t[k] = carry;
+        // x * a < a * n, so fewer than a subtractions bring it into range
+        while (t[k] || !lessWords(t, n.data.data())) t[k] -= subWords(t, k, n.data.data(), k);
+        BigInt res;
+        std::copy(t, t + k, res.data.begin());
+        res.normalize(k);
+        return res;
+    }
+
+    // a + b, a - b and a / 2 mod n, for a, b < n; being linear, they serve Montgomery
+    // and normal form alike
+    BigInt add(const BigInt& a, const BigInt& b) const {
+        uint64_t t[NUM_WORDS];
+        std::copy(a.data.begin(), a.data.begin() + k, t);
+        return reduceOnce(t, addWords(t, k, b.data.data(), k));
+    }
+
+    BigInt sub(const BigInt& a, const BigInt& b) const {
+        BigInt res = a;
+        if (subWords(res.data.data(), k, b.data.data(), k)) addWords(res.data.data(), k, n.data.data(), k);
+        res.normalize(k);
+        return res;
+    }
+
+    // For odd a, (a + n) / 2 without forming a + n, which may not fit
+    BigInt half(const BigInt& a) const {
+        if ((a.data[0] & 1) == 0) return a >> 1;
+        return (a >> 1) + (n >> 1) + 1;
+    }
+
+private:
+    // Below this modulus width the interleaved CIOS loop beats separate Karatsuba products
+    static constexpr size_t REDC_KARATSUBA_WORDS = 32;
+
+    // From this modulus width the IFMA product beats both 64-bit paths
+    static constexpr size_t IFMA_MIN_WORDS = 11;
+
+    static constexpr uint64_t DIGIT_MASK = (uint64_t(1) << 52) - 1;
+    // Room for the 52-bit digits of any n < 2^Bits, as the IFMA kernel lays them out
+    static constexpr size_t DIGITS = WordKernels::digits((Bits + 51) / 52);
+
+    // The m52 low digits of x, 52 bits each, zero-padded to DIGITS
+    void toDigits(const BigInt& x, uint64_t* d) const {
+        std::fill(d, d + DIGITS, 0);
+        for (size_t i = 0; i < m52; ++i) {
+            size_t w = 52 * i / 64, off = 52 * i % 64;
+            uint64_t v = x.data[w] >> off;
+            if (off > 12 && w + 1 < NUM_WORDS) v |= x.data[w + 1] << (64 - off);
+            d[i] = v & DIGIT_MASK;
+        }
+    }
+
+    // a * b * 2^(-52m) mod n: the kernel leaves a value below 2n, which may run one bit
+    // past the top word of n and is brought back by reduceOnce like the other paths
+    BigInt mulIfma(const BigInt& a, const BigInt& b) const {
+        uint64_t da[DIGITS], db[DIGITS], dr[DIGITS];
+        toDigits(a, da);
+        toDigits(b, db);
+        WordKernels::montMul52(dr, da, db, n52.data(), k52, m52);
+        uint64_t t[NUM_WORDS + 2] = {};
+        for (size_t i = 0; i <= m52; ++i) {
+            size_t w = 52 * i / 64, off = 52 * i % 64;
+            t[w] |= dr[i] << off;
+            if (off > 12) t[w + 1] |= dr[i] >> (64 - off);
+        }
+        return reduceOnce(t, t[k]);
+    }
+
+    // CIOS: one row of a * b[i] interleaved with one word of reduction
+    BigInt mulInterleaved(const BigInt& a, const BigInt& b) const {
+        uint64_t t[NUM_WORDS + 2] = {};
+        for (size_t i = 0; i < k; ++i) {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < k; ++j) {
+                __uint128_t sum = (__uint128_t)a.data[j] * b.data[i] + t[j] + carry;
+                t[j] = (uint64_t)sum;
+                carry = (uint64_t)(sum >> 64);
+            }
+            __uint128_t sum = (__uint128_t)t[k] + carry;
+            t[k] = (uint64_t)sum;
+            t[k + 1] = (uint64_t)(sum >> 64);
+
+            uint64_t m = t[0] * nInv;
+            sum = (__uint128_t)m * n.data[0] + t[0];
+            carry = (uint64_t)(sum >> 64);
+            for (size_t j = 1; j < k; ++j) {
+                sum = (__uint128_t)m * n.data[j] + t[j] + carry;
+                t[j - 1] = (uint64_t)sum;
+                carry = (uint64_t)(sum >> 64);
+            }
+            sum = (__uint128_t)t[k] + carry;
+            t[k - 1] = (uint64_t)sum;
+            t[k] = t[k + 1] + (uint64_t)(sum >> 64);
+        }
+        return reduceOnce(t, t[k]);
+    }
+
+    // Separated operand scanning: T = a * b, m = low(T * n') mod R, result = (T + m * n) / R.
+    // The two full products go through Karatsuba and m through the low-half kernel.
+    BigInt mulSeparated(const BigInt& a, const BigInt& b) const {
+        uint64_t t[2 * NUM_WORDS + 1];
+        mulKaratsuba(a.data.data(), b.data.data(), k, t);
+        t[2 * k] = 0;
+        return redcSeparated(t);
+    }
+
+    // As in mulLow(), GCC loses track of mulLow() filling m
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    // (T + m * n) / R with m = low(T * n') mod R, for the 2k + 1 word T in t
+    BigInt redcSeparated(uint64_t* t) const {
+        uint64_t m[NUM_WORDS], u[2 * NUM_WORDS];
+        mulLow(t, nPrime.data(), k, m);
+        mulKaratsuba(m, n.data.data(), k, u);
+        // The low k words of T + m * n are zero by construction of m
+        addWords(t, 2 * k + 1, u, 2 * k);
+        return reduceOnce(t + k, t[2 * k]);
+    }
+#pragma GCC diagnostic pop
+
+    // a < b over the low k words
+    bool lessWords(const uint64_t* a, const uint64_t* b) const {
+        if (k >= WordKernels::VECTOR_MIN_WORDS) {
+            size_t i = WordKernels::highestDifference(a, b, k);
+            return i < k && a[i] < b[i];
+        }
+        for (size_t i = k; i-- > 0;)
+            if (a[i] != b[i]) return a[i] < b[i];
+        return false;
     }
+
+    // The k-word value w plus carry * R, which is below 2n, reduced into [0, n)
+    BigInt reduceOnce(const uint64_t* w, uint64_t carry) const {
+        BigInt res;
+        std::copy(w, w + k, res.data.begin());
+        res.normalize(k);
+        // Subtract over k words so the borrow out of the top word cancels the carry
+        // instead of wrapping to 2^Bits
+        if (carry || res >= n) {
+            subWords(res.data.data(), k, n.data.data(), k);
+            res.normalize(k);
+        }
+        return res;
+    }
+
+    // x = -x mod R
+    void negate(uint64_t* x) const {
+        const uint64_t one[1] = {1};
+        for (size_t j = 0; j < k; ++j) x[j] = ~x[j];
+        addWords(x, k, one, 1);
+    }
+
+    BigInt n;
+    BigInt rModN;
+    BigInt r2;
+    uint64_t nInv;
+    // -n^-1 mod R over all k words, only for the separated path
+    std::array<uint64_t, NUM_WORDS> nPrime{};
+    size_t k;
+    // Digit count of n on the IFMA path, 0 when the 64-bit paths are in use
+    size_t m52 = 0;
+    std::array<uint64_t, DIGITS> n52{};
+    // -n^-1 mod 2^52
+    uint64_t k52 = 0;
 };
 
+template <size_t Bits>
+inline BigInt<Bits> BigInt<Bits>::modExp(BigInt base, BigInt exp, const BigInt& mod) {
+    if (mod == ZERO) throw std::runtime_error("modulo by zero");
+    if (mod.data[0] & 1) return Montgomery(mod).exp(base, exp);
+    BigInt result(1);
+    base %= mod;
+    while (exp != ZERO) {
+        if (exp.data[0] & 1) result = modMul(result, base, mod);
+        exp >>= 1;
+        base = modSqr(base, mod);
+    }
+    return result;
+}
+
+template <size_t Bits>
+inline BigInt<Bits> BigInt<Bits>::modMul(const BigInt& a, const BigInt& b, const BigInt& mod) {
+    if (mod == ZERO) throw std::runtime_error("modulo by zero");
+    BigInt x = a < mod ? a : a % mod;
+    BigInt y = b < mod ? b : b % mod;
+    if (x.used + y.used <= NUM_WORDS) return (x * y) % mod;
+    // x * y would not fit in Bits bits: double-and-add over the bits of x, each step below 2 * mod
+    BigInt r;
+    for (size_t i = x.bitLength(); i-- > 0;) {
+        BigInt twice = r + r;
+        r = twice < r || twice >= mod ? twice - mod : twice;
+        if ((x.data[i / 64] >> (i % 64)) & 1) {
+            BigInt sum = r + y;
+            r = sum < r || sum >= mod ? sum - mod : sum;
+        }
+    }
+    return r;
+}
+
+template <size_t Bits>
+inline BigInt<Bits> BigInt<Bits>::modSqr(const BigInt& a, const BigInt& mod) {
+    if (mod == ZERO) throw std::runtime_error("modulo by zero");
+    BigInt x = a < mod ? a : a % mod;
+    if (2 * x.used <= NUM_WORDS) return (x * x) % mod;
+    return modMul(x, x, mod);
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::hasSmallFactor(const BigInt& n, size_t count) {
+    const TrialTable& table = trialTable();
+    count = std::min(count, table.primes.size());
+    for (const auto& g : table.groups) {
+        if (g.begin >= count) break;
+        uint64_t rem = n.modSmall(g.product);
+        for (size_t i = g.begin; i < g.end && i < count; ++i)
+            if (rem % table.primes[i] == 0) return n != BigInt(table.primes[i]);
+    }
+    return false;
+}
+
+template <size_t Bits>
+inline int BigInt<Bits>::screen(const BigInt& n, size_t trialPrimes) {
+    if (n <= ONE) return 0;
+    if (n == TWO || n == BigInt(3)) return 1;
+    if ((n.data[0] & 1) == 0) return 0;
+    // Cheap rejection of most composites before any exponentiation
+    if (trialPrimes > 0) {
+        if (hasSmallFactor(n, trialPrimes)) return 0;
+        // With no factor up to p, anything below p^2 is prime
+        uint64_t largest = trialTable().primes[std::min(trialPrimes, TRIAL_PRIMES) - 1];
+        if (n < BigInt(largest * largest)) return 1;
+    }
+    return -1;
+}
+
+template <size_t Bits>
+inline int BigInt<Bits>::splitPowerOfTwo(const BigInt& n, BigInt& d) {
+    d = n - 1;
+    int r = 0;
+    while (((d.data[r / 64] >> (r % 64)) & 1) == 0) ++r;
+    d >>= r;
+    return r;
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::isPrime(const BigInt& n, PrimalityTest test, int rounds, size_t trialPrimes) {
+    int screened = screen(n, trialPrimes);
+    if (screened >= 0) return screened;
+    BigInt d;
+    int r = splitPowerOfTwo(n, d);
+    // One context per candidate, shared by every round
+    Montgomery mont(n);
+    if (test == PrimalityTest::RandomBases) {
+        for (int i = 0; i < rounds; ++i)
+            if (!strongRound(mont, d, r, n <= BigInt(4) ? TWO : randomBase(n))) return false;
+        return true;
+    }
+    if (test == PrimalityTest::FixedBases && rounds < 1) return true;
+    return strongRound(mont, d, r, TWO) && laterRounds(mont, d, r, test, rounds);
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::laterRounds(const Montgomery& mont, const BigInt& d, int r, PrimalityTest test,
+                                      int rounds) {
+    const BigInt& n = mont.modulus();
+    if (test == PrimalityTest::RandomBases) {
+        for (int i = 0; i < rounds; ++i)
+            if (!strongRound(mont, d, r, n <= BigInt(4) ? TWO : randomBase(n))) return false;
+        return true;
+    }
+    size_t fixed = 0;
+    if (test == PrimalityTest::FixedBases) fixed = std::min<size_t>(std::max(rounds, 0), TRIAL_PRIMES + 1);
+    else if (test == PrimalityTest::Auto) fixed = deterministicBases(n);
+    if (fixed > 0 || test == PrimalityTest::FixedBases) {
+        for (size_t i = 1; i < fixed; ++i)
+            if (!strongRound(mont, d, r, BigInt(smallPrime(i)))) return false;
+        return true;
+    }
+    return isStrongLucasProbablePrime(n);
+}
+
+template <size_t Bits>
+inline std::vector<bool> BigInt<Bits>::isPrimeBatch(const std::vector<BigInt>& candidates, PrimalityTest test,
+                                                    int rounds, size_t trialPrimes, Base2Batch base2) {
+    std::vector<bool> prime(candidates.size());
+    // Everything trial division leaves open goes through the base-2 round together
+    std::vector<size_t> open;
+    std::vector<BigInt> pending;
+    uint64_t trialRejected = 0, base2Rejected = 0, roundsRejected = 0;
+    {
+        Stats::Timer timer(Stats::Prefilter);
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            int screened = screen(candidates[i], trialPrimes);
+            trialRejected += screened == 0;
+            if (screened >= 0) {
+                prime[i] = screened;
+            } else if (test == PrimalityTest::FixedBases && rounds < 1) {
+                prime[i] = true;
+            } else {
+                open.push_back(i);
+                pending.push_back(candidates[i]);
+            }
+        }
+    }
+    Stats::Timer timer(Stats::MillerRabin);
+    std::unique_ptr<bool[]> passed(new bool[pending.size()]);
+    base2(pending.data(), pending.size(), passed.get());
+    for (size_t j = 0; j < open.size(); ++j) {
+        if (!passed[j]) {
+            ++base2Rejected;
+            continue;
+        }
+        BigInt d;
+        int r = splitPowerOfTwo(pending[j], d);
+        prime[open[j]] = laterRounds(Montgomery(pending[j]), d, r, test, rounds);
+        roundsRejected += !prime[open[j]];
+    }
+    Stats::add(Stats::Tested, candidates.size());
+    Stats::add(Stats::TrialRejected, trialRejected);
+    Stats::add(Stats::Base2Rejected, base2Rejected);
+    Stats::add(Stats::RoundsRejected, roundsRejected);
+    return prime;
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::isStrongProbablePrime(const BigInt& n, uint64_t base) {
+    BigInt d;
+    int r = splitPowerOfTwo(n, d);
+    return strongRound(Montgomery(n), d, r, BigInt(base));
+}
+
+template <size_t Bits>
+inline void BigInt<Bits>::isStrongProbablePrimeBatch(const BigInt* n, size_t count, bool* passed) {
+    if (!WordKernels::hasIfma()) {
+        for (size_t i = 0; i < count; ++i) passed[i] = isStrongProbablePrime(n[i], 2);
+        return;
+    }
+    // Odd candidates above 2 fill the lanes in order; a short last group rides along with
+    // copies of its first candidate, and anything else takes the one-by-one round
+    size_t lane[BATCH_LANES], filled = 0;
+    auto flush = [&] {
+        BigInt group[BATCH_LANES];
+        bool out[BATCH_LANES];
+        for (size_t j = 0; j < BATCH_LANES; ++j) group[j] = n[lane[j < filled ? j : 0]];
+        strongBase2Lanes(group, out);
+        for (size_t j = 0; j < filled; ++j) passed[lane[j]] = out[j];
+        filled = 0;
+    };
+    for (size_t i = 0; i < count; ++i) {
+        if ((n[i].data[0] & 1) && n[i] > TWO) {
+            lane[filled++] = i;
+            if (filled == BATCH_LANES) flush();
+        } else {
+            passed[i] = isStrongProbablePrime(n[i], 2);
+        }
+    }
+    if (filled == 1) passed[lane[0]] = isStrongProbablePrime(n[lane[0]], 2);
+    else if (filled) flush();
+}
+
+template <size_t Bits>
+inline void BigInt<Bits>::strongBase2Lanes(const BigInt* n, bool* passed) {
+    constexpr size_t L = BATCH_LANES;
+    constexpr uint64_t MASK = (uint64_t(1) << 52) - 1;
+    // R = 2^(52m) >= 16 n for every lane, so the lanes skip their final subtractions
+    size_t bits = 0;
+    for (size_t j = 0; j < L; ++j) bits = std::max(bits, n[j].bitLength());
+    size_t m = (bits + 4 + 51) / 52;
+    constexpr size_t M = (Bits + 4 + 51) / 52;
+    static_assert(M <= WordKernels::LANE_DIGITS_MAX, "lane kernel too narrow for this width");
+    uint64_t nd[8 * M], x[8 * M], k0[L];
+    auto scatter = [&](const BigInt& v, uint64_t* out, size_t lane) {
+        for (size_t t = 0; t < m; ++t) {
+            size_t w = 52 * t / 64, off = 52 * t % 64;
+            uint64_t digit = w < NUM_WORDS ? v.data[w] >> off : 0;
+            if (off > 12 && w + 1 < NUM_WORDS) digit |= v.data[w + 1] << (64 - off);
+            out[8 * t + lane] = digit & MASK;
+        }
+    };
+    BigInt d[L], one[L], minusOne[L];
+    int r[L];
+    size_t dBits = 0;
+    for (size_t j = 0; j < L; ++j) {
+        scatter(n[j], nd, j);
+        uint64_t inv = n[j].data[0];
+        for (int i = 0; i < 5; ++i) inv *= 2 - n[j].data[0] * inv;
+        k0[j] = (~inv + 1) & MASK;
+        // R mod n, doubling up from the top bit of n and carrying out of the top word
+        size_t top = n[j].bitLength() - 1;
+        one[j] = ONE << top;
+        for (size_t i = top; i < 52 * m; ++i) {
+            bool carry = one[j].data[NUM_WORDS - 1] >> 63;
+            one[j] <<= 1;
+            if (carry || one[j] >= n[j]) one[j] -= n[j];
+        }
+        minusOne[j] = n[j] - one[j];
+        scatter(one[j], x, j);
+        r[j] = splitPowerOfTwo(n[j], d[j]);
+        dBits = std::max(dBits, d[j].bitLength());
+    }
+    // 2^d_j: square every lane, then double the lanes whose exponent bit is set. A lane
+    // with a shorter d squares R mod n, which Montgomery squaring leaves in place.
+    size_t stride = std::max<uint64_t>(1, Deadline::POLL_WORK / (L * m * m));
+    Stats::add(Stats::ModExp, L);
+    Stats::add(Stats::ModSqr, L * dBits);
+    for (size_t i = dBits; i-- > 0;) {
+        if ((dBits - i) % stride == 0 && Deadline::interrupted()) {
+            std::fill(passed, passed + L, false);
+            return;
+        }
+        uint8_t twice = 0;
+        for (size_t j = 0; j < L; ++j) twice |= (uint8_t)(((d[j].data[i / 64] >> (i % 64)) & 1) << j);
+        WordKernels::montMul52x8(x, x, x, nd, k0, m, twice);
+    }
+    // Lane j reduced below n: digits back to words, then at most three subtractions of n
+    auto gather = [&](size_t lane) {
+        uint64_t words[NUM_WORDS + 2] = {};
+        for (size_t t = 0; t < m; ++t) {
+            size_t w = 52 * t / 64, off = 52 * t % 64;
+            uint64_t digit = x[8 * t + lane];
+            words[w] |= digit << off;
+            if (off > 12) words[w + 1] |= digit >> (64 - off);
+        }
+        BigInt v;
+        std::copy(words, words + NUM_WORDS, v.data.begin());
+        v.normalize(NUM_WORDS);
+        // Below 4n, which for n near 2^Bits spills past the top word: a subtraction that
+        // wraps below zero takes one off the spill
+        uint64_t spill = words[NUM_WORDS];
+        while (spill || v >= n[lane]) {
+            if (v < n[lane]) --spill;
+            v -= n[lane];
+        }
+        return v;
+    };
+    bool open[L];
+    size_t remaining = 0;
+    for (size_t j = 0; j < L; ++j) {
+        BigInt v = gather(j);
+        passed[j] = v == one[j] || v == minusOne[j];
+        open[j] = !passed[j] && r[j] > 1;
+        remaining += open[j];
+    }
+    // The squarings, in lockstep until every lane has either hit -1 or run out of them
+    for (int s = 1; remaining; ++s) {
+        WordKernels::montMul52x8(x, x, x, nd, k0, m, 0);
+        Stats::add(Stats::ModSqr, L);
+        for (size_t j = 0; j < L; ++j) {
+            if (!open[j]) continue;
+            if (gather(j) == minusOne[j]) passed[j] = true;
+            if (passed[j] || s + 1 >= r[j]) {
+                open[j] = false;
+                --remaining;
+            }
+        }
+    }
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::strongRound(const Montgomery& mont, const BigInt& d, int r, const BigInt& a) {
+    const BigInt& n = mont.modulus();
+    if (a >= n) return true; // witness must be a unit mod n (small prime bases test themselves)
+    // Witnesses are compared against 1 and n-1 in Montgomery form
+    const BigInt one = mont.one();
+    const BigInt minusOne = n - one;
+    BigInt x = a <= BigInt(Montgomery::SMALL_BASE_MAX) ? mont.expMontSmall(a.data[0], d)
+                                                               : mont.expMont(mont.toMont(a), d);
+    if (x == one || x == minusOne) return true;
+    for (int j = 1; j < r; ++j) {
+        x = mont.sqr(x);
+        if (x == minusOne) {
+            Stats::add(Stats::ModSqr, j);
+            return true;
+        }
+    }
+    Stats::add(Stats::ModSqr, r - 1);
+    return false;
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::isStrongLucasProbablePrime(const BigInt& n) {
+    // Selfridge's D; a perfect square has none, so it is ruled out once the search drags on
+    int64_t D = 5;
+    for (int tries = 1;; ++tries, D = D > 0 ? -(D + 2) : -D + 2) {
+        int j = jacobi(D, n);
+        if (j == -1) break;
+        if (j == 0 && n != BigInt(D > 0 ? D : -D)) return false;
+        if (tries == 8 && isPerfectSquare(n)) return false;
+    }
+    int64_t Q = (1 - D) / 4;
+    uint64_t absD = D > 0 ? D : -D, absQ = Q > 0 ? Q : -Q;
+    if (absQ > 1 && n.modSmall(absQ) == 0 && n != BigInt(absQ)) return false;
+
+    // n + 1 = d * 2^s: s is the run of low one bits of n, and d = (n >> s) + 1
+    int s = 0;
+    while ((n.data[s / 64] >> (s % 64)) & 1) ++s;
+    BigInt d = (n >> s) + 1;
+
+    // U_k, V_k and Q^k in Montgomery form, by the doubling and increment formulas
+    //   U_2k = U_k V_k, V_2k = V_k^2 - 2 Q^k, U_k+1 = (U_k + V_k) / 2, V_k+1 = (D U_k + V_k) / 2
+    Montgomery mont(n);
+    auto times = [&](const BigInt& x, uint64_t c) {
+        return c <= Montgomery::SMALL_BASE_MAX ? mont.mulSmall(x, c) : mont.mul(x, mont.toMont(BigInt(c)));
+    };
+    BigInt U = mont.one(), V = mont.one();
+    BigInt q = times(mont.one(), absQ);
+    if (Q < 0) q = mont.sub(ZERO, q);
+    BigInt qk = q;
+    size_t stride = mont.pollStride(), steps = 0, setBits = 0;
+    Stats::add(Stats::ModExp);
+    for (size_t i = d.bitLength() - 1; i-- > 0;) {
+        // Cut short, the test fails, as an interrupted exponentiation does
+        if (++steps % stride == 0 && Deadline::interrupted()) return false;
+        U = mont.mul(U, V);
+        V = mont.sub(mont.sqr(V), mont.add(qk, qk));
+        qk = mont.sqr(qk);
+        if ((d.data[i / 64] >> (i % 64)) & 1) {
+            BigInt du = times(U, absD);
+            if (D < 0) du = mont.sub(ZERO, du);
+            U = mont.half(mont.add(U, V));
+            V = mont.half(mont.add(du, V));
+            qk = mont.mul(qk, q);
+            ++setBits;
+        }
+    }
+    Stats::add(Stats::ModMul, steps + setBits);
+    Stats::add(Stats::ModSqr, 2 * steps);
+    if (U == ZERO || V == ZERO) return true;
+    for (int r = 1; r < s; ++r) {
+        V = mont.sub(mont.sqr(V), mont.add(qk, qk));
+        Stats::add(Stats::ModSqr);
+        if (V == ZERO) return true;
+        qk = mont.sqr(qk);
+        Stats::add(Stats::ModSqr);
+    }
+    return false;
+}
+
+template <size_t Bits>
+inline size_t BigInt<Bits>::deterministicBases(const BigInt& n) {
+    // n below limit needs the first `bases` primes
+    static const struct { __uint128_t limit; size_t bases; } table[] = {
+        {2047, 1},
+        {1373653, 2},
+        {25326001, 3},
+        {3215031751, 4},
+        {2152302898747, 5},
+        {3474749660383, 6},
+        {341550071728321, 7},
+        {3825123056546413051, 9},
+        {(__uint128_t)0x437a << 64 | 0xe92817f9fc85b7e5, 12}, // 318665857834031151167461
+        {(__uint128_t)0x2be69 << 64 | 0x51adc5b22410a5fd, 13}, // 3317044064679887385961981
+    };
+    if (n.used > 2) return 0;
+    __uint128_t v = (__uint128_t)n.data[1] << 64 | n.data[0];
+    for (const auto& t : table)
+        if (v < t.limit) return t.bases;
+    return 0;
+}
+
+template <size_t Bits>
+inline BigInt<Bits> BigInt<Bits>::randomBase(const BigInt& n) {
+    static thread_local std::mt19937_64 engine{std::random_device{}()};
+    // Rejection sampling over the bit length of n - 3, then shifted up by 2
+    BigInt span = n - 3;
+    size_t bits = span.bitLength();
+    BigInt x;
+    do {
+        for (size_t i = 0; i < span.used; ++i) x.data[i] = engine();
+        if (bits % 64) x.data[span.used - 1] &= (uint64_t(1) << (bits % 64)) - 1;
+        x.normalize(span.used);
+    } while (x >= span);
+    return x + 2;
+}
+
+template <size_t Bits>
+inline int BigInt<Bits>::jacobi(int64_t d, const BigInt& n) {
+    // (d/n) = (-1/n)^[d < 0] (|d|/n), and for odd |d| reciprocity turns (|d|/n) into (n mod |d| / |d|)
+    uint64_t a = d > 0 ? d : -d;
+    int sign = d < 0 && (n.data[0] & 3) == 3 ? -1 : 1;
+    if ((a & 3) == 3 && (n.data[0] & 3) == 3) sign = -sign;
+    uint64_t x = n.modSmall(a), m = a;
+    while (x != 0) {
+        while ((x & 1) == 0) {
+            x >>= 1;
+            if ((m & 7) == 3 || (m & 7) == 5) sign = -sign;
+        }
+        std::swap(x, m);
+        if ((x & 3) == 3 && (m & 3) == 3) sign = -sign;
+        x %= m;
+    }
+    return m == 1 ? sign : 0;
+}
+
+template <size_t Bits>
+inline bool BigInt<Bits>::isPerfectSquare(const BigInt& n) {
+    // Newton's iteration from above: x <- (x + n / x) / 2 decreases to floor(sqrt(n))
+    BigInt x = ONE << ((n.bitLength() + 1) / 2);
+    while (true) {
+        BigInt y = (x + n / x) >> 1;
+        if (y >= x) break;
+        x = y;
+    }
+    return x * x == n;
+}
+
+template <size_t Bits> inline const BigInt<Bits> BigInt<Bits>::ZERO{0};
+template <size_t Bits> inline const BigInt<Bits> BigInt<Bits>::ONE{1};
+template <size_t Bits> inline const BigInt<Bits> BigInt<Bits>::TWO{2};
+
+using BigInt4096 = BigInt<4096>;
+
 #endif // BIGINT4096_HPP
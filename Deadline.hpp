@@ -0,0 +1,92 @@
+#ifndef DEADLINE_HPP
+#define DEADLINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// -----------------------------------
+// Deadline: cooperative cancellation token with a millisecond deadline, shared by a
+// task and the workers running its pieces. Nothing is stopped from outside: loops
+// call stopped() or poll() between units of work and wind down on their own. Code
+// that is not handed the token (BigInt's exponentiations, the prime counter)
+// reaches it through interrupted(), which polls the token that a Scope has installed
+// on the calling thread.
+// -----------------------------------
+class Deadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Starts the clock; a zero limit never expires. Clears an earlier cancel or expiry.
+    // Call it before handing the token to other threads.
+    void arm(std::chrono::milliseconds limit) {
+        start = Clock::now();
+        end = start + limit;
+        limited = limit.count() > 0;
+        timedOut = false;
+        halted = false;
+    }
+
+    // Stops everything that checks the token, until resume()
+    void cancel() { halted = true; }
+
+    // Lifts a cancel(), but not an expiry
+    void resume() {
+        if (!timedOut) halted = false;
+    }
+
+    // Cancelled or expired as of the last poll: one atomic load, for tight loops
+    bool stopped() const { return halted.load(std::memory_order_relaxed); }
+
+    // stopped(), after reading the clock: the check at the end of a unit of work
+    bool poll() {
+        if (stopped()) return true;
+        if (limited && Clock::now() >= end) {
+            timedOut = true;
+            halted = true;
+        }
+        return stopped();
+    }
+
+    // Whether the deadline, rather than a cancel, stopped the work
+    bool expired() const { return timedOut; }
+
+    uint64_t elapsedMs() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    }
+
+    // Makes a token the calling thread's current one for the Scope's lifetime
+    class Scope {
+    public:
+        explicit Scope(Deadline& token) : previous(current()) { current() = &token; }
+        ~Scope() { current() = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Deadline* previous;
+    };
+
+    // poll() on the calling thread's current token; false when none is installed
+    static bool interrupted() {
+        Deadline* token = current();
+        return token && token->poll();
+    }
+
+    // Word products a long inner loop does between interrupted() calls: about 0.1 ms
+    static constexpr uint64_t POLL_WORK = 1 << 18;
+
+private:
+    std::atomic<bool> halted{false};
+    std::atomic<bool> timedOut{false};
+    bool limited = false;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start;
+
+    static Deadline*& current() {
+        thread_local Deadline* token = nullptr;
+        return token;
+    }
+};
+
+#endif // DEADLINE_HPP
@@ -0,0 +1,135 @@
+#ifndef INCREMENTALSIEVE_HPP
+#define INCREMENTALSIEVE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include "BigInt4096.hpp"
+#include "SegmentedSieve.hpp"
+#include "Wheel.hpp"
+#include "Stats.hpp"
+
+// -----------------------------------
+// IncrementalSieve: sieves successive windows of candidates below (Down) or
+// above (Up) a starting value, for previous/next-prime searches. The start's
+// residues modulo a small-prime table are computed once; after that each
+// window costs one pass over the table, and residues slide by subtracting or
+// adding the window width. Away from the bottom of the number line the window
+// is read along the mod-210 wheel, so the table's first four primes need no
+// crossing off. Only candidates with no factor in the table are returned, so
+// they still need a probable-prime test.
+// -----------------------------------
+template <typename Int>
+class IncrementalSieve {
+public:
+    using Direction = Wheel::Direction;
+
+    static constexpr uint64_t WINDOW = 8192;
+    static constexpr uint32_t DEFAULT_BOUND = 1 << 16;
+
+    // Sieving primes are those up to bound; candidates are start, start -/+ 1, ...
+    IncrementalSieve(const Int& start, Direction dir, uint32_t bound = DEFAULT_BOUND)
+        : base(start), dir(dir), table(primeTable(bound)), primes(*table), marks(WINDOW),
+          wheelSkip(std::upper_bound(primes.begin(), primes.end(), Wheel::PRIMES[3]) - primes.begin()) {
+        residues.reserve(primes.size());
+        step.reserve(primes.size());
+        for (uint32_t p : primes) {
+            residues.push_back((uint32_t)residue(start, p));
+            step.push_back((uint32_t)(WINDOW % p));
+        }
+        // Down stops at 2, Up at the largest value Int can hold
+        done = dir == Direction::Down && start < Int(2);
+    }
+
+    // Replaces out with the survivors of the next window in search order.
+    // Returns false once the range is exhausted.
+    bool nextWindow(std::vector<Int>& out) {
+        out.clear();
+        if (done) return false;
+        Stats::Timer timer(Stats::Sieve);
+        // Candidates left in the range after this one, capped at one window
+        Int room = dir == Direction::Down ? base - 2 : ~Int(0) - base;
+        uint64_t len = room < Int(WINDOW - 1) ? (uint64_t)room + 1 : WINDOW;
+        std::fill(marks.begin(), marks.begin() + len, 0);
+        Int lowest = dir == Direction::Down ? base - (len - 1) : base;
+        // The wheel steps over the multiples of its primes, but not over the primes themselves
+        bool wheel = lowest >= Int(Wheel::FIRST);
+        for (size_t i = wheel ? wheelSkip : 0; i < primes.size(); ++i) {
+            uint64_t p = primes[i];
+            // Offset o holds base - o (Down) or base + o (Up); p divides it when o = -/+ base mod p
+            uint64_t o = dir == Direction::Down ? residues[i] : (p - residues[i]) % p;
+            for (; o < len; o += p) marks[o] = 1;
+        }
+        // Near the bottom of the number line a table prime can be a candidate itself
+        if (lowest <= Int(primes.back())) {
+            for (uint32_t p : primes) {
+                Int value(p);
+                Int offset = dir == Direction::Down ? base - value : value - base;
+                if (dir == Direction::Down ? value <= base : value >= base)
+                    if (offset < Int(len)) marks[(uint64_t)offset] = 0;
+            }
+        }
+        if (wheel) {
+            Wheel spokes(Wheel::residue(base), dir);
+            for (uint64_t o = spokes.first(); o < len; o += spokes.next())
+                if (!marks[o]) out.push_back(dir == Direction::Down ? base - o : base + o);
+        } else {
+            for (uint64_t o = 0; o < len; ++o) {
+                if (marks[o]) continue;
+                out.push_back(dir == Direction::Down ? base - o : base + o);
+            }
+        }
+        Stats::add(Stats::Sieved, len);
+        Stats::add(Stats::SieveRejected, len - out.size());
+        advance(len);
+        return true;
+    }
+
+private:
+    Int base;
+    Direction dir;
+    bool done;
+    std::shared_ptr<const std::vector<uint32_t>> table;
+    const std::vector<uint32_t>& primes;
+    // base mod p, kept current as the window slides
+    std::vector<uint32_t> residues;
+    // WINDOW mod p
+    std::vector<uint32_t> step;
+    std::vector<uint8_t> marks;
+    // Table primes the wheel already covers: 2, 3, 5 and 7
+    size_t wheelSkip;
+
+    // The default table is built once and shared by every search
+    static std::shared_ptr<const std::vector<uint32_t>> primeTable(uint32_t bound) {
+        static const auto shared = std::make_shared<const std::vector<uint32_t>>(
+            SegmentedSieve::sievingPrimes((uint64_t)DEFAULT_BOUND * DEFAULT_BOUND));
+        if (bound == DEFAULT_BOUND) return shared;
+        return std::make_shared<const std::vector<uint32_t>>(SegmentedSieve::sievingPrimes((uint64_t)bound * bound));
+    }
+
+    static uint64_t residue(uint64_t v, uint32_t p) { return v % p; }
+    template <size_t Bits>
+    static uint64_t residue(const BigInt<Bits>& v, uint32_t p) { return v.modSmall(p); }
+
+    void advance(uint64_t len) {
+        if (len < WINDOW) {
+            done = true;
+            return;
+        }
+        if (dir == Direction::Down) {
+            base -= WINDOW;
+            for (size_t i = 0; i < primes.size(); ++i)
+                residues[i] = (residues[i] + primes[i] - step[i]) % primes[i];
+            done = base < Int(2);
+        } else {
+            Int next = base + WINDOW;
+            done = next < base;
+            base = next;
+            for (size_t i = 0; i < primes.size(); ++i)
+                residues[i] = (residues[i] + step[i]) % primes[i];
+        }
+    }
+};
+
+#endif // INCREMENTALSIEVE_HPP
@@ -0,0 +1,810 @@
+#ifndef OPRIME_HPP
+#define OPRIME_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "BigInt4096.hpp"
+#include "SegmentedSieve.hpp"
+#include "IncrementalSieve.hpp"
+#include "Wheel.hpp"
+#include "ThreadPool.hpp"
+#include "PrimeArena.hpp"
+#include "PrimeCache.hpp"
+#include "PrimeCount.hpp"
+#include "Deadline.hpp"
+#include "Stats.hpp"
+
+// -----------------------------------
+// oprime: the prime engines as a library, with a C ABI in oprime.h. An Engine
+// answers one query at a time on its own worker pool, under the time limit of
+// its Options, and keeps what it builds (sieving tables, prime-count
+// checkpoints) for the queries after it; the free functions run one query on
+// a throwaway Engine. Values are BigInt4096 at the surface and uint64_t or the
+// narrowest BigInt width inside. Nothing is printed: answers are returned or
+// handed to a callback, and a query that runs out of time throws Timeout.
+// -----------------------------------
+namespace oprime {
+
+using PrimalityTest = ::PrimalityTest;
+
+// Where the bulk base-2 rounds of wide candidates run; confirmation stays on the CPU
+enum class Device { CPU, GPU };
+
+// A device's base-2 round, one Base2Batch per width the engines run at. Impl provides
+// template <size_t Bits> static void base2(const BigInt<Bits>*, size_t, bool* passed),
+// setting passed[i] when candidate i is a strong probable prime to base 2.
+struct Backend {
+    template <size_t Bits>
+    using Batch = typename BigInt<Bits>::Base2Batch;
+
+    std::tuple<Batch<128>, Batch<256>, Batch<512>, Batch<1024>, Batch<2048>, Batch<4096>> batches;
+
+    template <typename Impl>
+    static Backend of() {
+        return Backend{{&Impl::template base2<128>, &Impl::template base2<256>, &Impl::template base2<512>,
+                        &Impl::template base2<1024>, &Impl::template base2<2048>, &Impl::template base2<4096>}};
+    }
+
+    template <size_t Bits>
+    Batch<Bits> batch() const { return std::get<Batch<Bits>>(batches); }
+};
+
+namespace detail {
+
+struct CpuBase2 {
+    template <size_t Bits>
+    static void base2(const BigInt<Bits>* n, size_t count, bool* passed) {
+        BigInt<Bits>::isStrongProbablePrimeBatch(n, count, passed);
+    }
+};
+
+// Registered backends by device; the CPU slot is always filled
+struct Backends {
+    std::mutex lock;
+    std::unique_ptr<Backend> gpu;
+
+    static Backends& get() {
+        static Backends backends;
+        return backends;
+    }
+};
+
+} // namespace detail
+
+// Makes the device available to Engines created from now on. This build ships only the
+// CPU backend; an accelerator library registers its own at startup.
+inline void register_backend(Device device, const Backend& backend) {
+    if (device == Device::CPU) return;
+    auto& backends = detail::Backends::get();
+    std::lock_guard<std::mutex> guard(backends.lock);
+    backends.gpu = std::make_unique<Backend>(backend);
+}
+
+// Whether a backend is registered for the device
+inline bool device_available(Device device) {
+    if (device == Device::CPU) return true;
+    auto& backends = detail::Backends::get();
+    std::lock_guard<std::mutex> guard(backends.lock);
+    return backends.gpu != nullptr;
+}
+
+// The device's backend, or the CPU one when it has none
+inline Backend device_backend(Device device) {
+    if (device != Device::CPU) {
+        auto& backends = detail::Backends::get();
+        std::lock_guard<std::mutex> guard(backends.lock);
+        if (backends.gpu) return *backends.gpu;
+    }
+    return Backend::of<detail::CpuBase2>();
+}
+
+// Thrown when the time limit runs out; what() says how far the work got
+class Timeout : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct Options {
+    unsigned threads = 1;
+    // Per query; zero is no limit
+    std::chrono::milliseconds timeout{0};
+    // Where nth_prime() keeps prime-count checkpoints; none when empty
+    std::string cache_dir;
+    // How candidates wider than 64 bits are tested; native ones are always deterministic
+    PrimalityTest primality = PrimalityTest::Auto;
+    // Miller-Rabin rounds for FixedBases and RandomBases
+    int rounds = 5;
+    // Unavailable devices fall back to the CPU
+    Device device = Device::CPU;
+};
+
+// Not safe to share between threads: run one Engine per thread for concurrent queries
+class Engine {
+public:
+    explicit Engine(const Options& options = Options())
+        : timeout(options.timeout), cache(options.cache_dir), primality(options.primality), rounds(options.rounds),
+          base2(device_backend(options.device)), pool(options.threads) {}
+
+    // The nth prime, counting 2 as the first; 0 for n = 0
+    BigInt4096 nth_prime(const BigInt4096& n) {
+        start();
+        Deadline::Scope scope(deadline);
+        // p_n < n (ln n + ln ln n) keeps the answer below 2^64 for n < 2^58, and within
+        // 8 bits of n for any n this can reach
+        if (n.bitLength() <= 58) return BigInt4096(native_nth_prime((uint64_t)n));
+        return with_width(n.bitLength() + 8, [&](auto zero) {
+            using Int = decltype(zero);
+            return BigInt4096(compute_nth_prime<Int>(Int(n)));
+        });
+    }
+
+    // The largest prime at most n; 0 below 2
+    BigInt4096 prev_prime(const BigInt4096& n) {
+        start();
+        Deadline::Scope scope(deadline);
+        if (n.bitLength() <= 64) return BigInt4096(compute_prime_less_than<uint64_t>((uint64_t)n));
+        return with_width(n.bitLength(), [&](auto zero) {
+            using Int = decltype(zero);
+            return BigInt4096(compute_prime_less_than<Int>(Int(n)));
+        });
+    }
+
+    // The smallest prime at least n; 0 when it would not fit in BigInt4096
+    BigInt4096 next_prime(const BigInt4096& n) {
+        start();
+        Deadline::Scope scope(deadline);
+        // A native search that runs off the top of uint64_t continues in BigInt; there is a
+        // prime below 2n, so one bit of headroom keeps the wider search in range
+        BigInt4096 result(0);
+        if (n.bitLength() <= 64) result = BigInt4096(compute_prime_at_least<uint64_t>((uint64_t)n));
+        if (result == BigInt4096(0))
+            result = with_width(n.bitLength() + 1, [&](auto zero) {
+                using Int = decltype(zero);
+                return BigInt4096(compute_prime_at_least<Int>(Int(n)));
+            });
+        return result;
+    }
+
+    // The number of primes at most n. Throws std::invalid_argument from 2^64 up.
+    uint64_t count_primes(const BigInt4096& n) {
+        start();
+        Deadline::Scope scope(deadline);
+        if (n.bitLength() > 64) throw std::invalid_argument("count supports N below 2^64 only");
+        uint64_t count = PrimeCounter::pi((uint64_t)n);
+        // Lucy's sieve has no partial count to report
+        if (deadline.expired())
+            throw Timeout("the count of primes up to " + std::to_string((uint64_t)n) + " did not finish");
+        return count;
+    }
+
+    // Calls fn(p) for every prime p in [lo, hi], in increasing order, and returns how many
+    // there were. p is a uint64_t when hi is below 2^64 and otherwise a PrimeView of the
+    // narrowest width past hi: the prime's words in place, valid for the call, with value()
+    // for a BigInt copy. fn should take both (a generic lambda does). fn runs on the calling
+    // thread. On a timeout fn has seen every prime up to where the Timeout says.
+    template <typename Fn>
+    uint64_t primes_in_range(const BigInt4096& lo, const BigInt4096& hi, Fn&& fn) {
+        start();
+        Deadline::Scope scope(deadline);
+        if (hi < lo) return 0;
+        if (hi.bitLength() <= 64) {
+            uint64_t a = (uint64_t)lo, b = (uint64_t)hi;
+            // A range narrower than sqrt(hi) costs less to test than the sieving table up to sqrt(hi)
+            if ((double)(b - a) < std::sqrt((double)b)) return search_primes_in_range(a, b, fn);
+            return sieve_primes_in_range(a, b, fn);
+        }
+        // One bit of headroom so the candidate after hi cannot wrap
+        return with_width(hi.bitLength() + 1, [&](auto zero) {
+            using Int = decltype(zero);
+            return compute_primes_in_range<Int>(Int(lo), Int(hi), fn);
+        });
+    }
+
+    // Milliseconds since the current or the last query started
+    uint64_t elapsed_ms() const { return deadline.elapsedMs(); }
+
+    // False when the last nth_prime() could not write its new checkpoints to the cache
+    bool cache_saved() const { return !cache_failed; }
+
+private:
+    std::chrono::milliseconds timeout;
+    PrimeCache cache;
+    bool cache_failed = false;
+    PrimalityTest primality;
+    int rounds;
+    // Options::device's backend, fixed for the Engine's lifetime
+    Backend base2;
+    ThreadPool pool;
+    // The time limit of the running query, and the stop signal for its in-flight chunks
+    Deadline deadline;
+
+    // Every query starts the clock, then makes the deadline current on the calling thread
+    void start() {
+        deadline.arm(timeout);
+        cache_failed = false;
+    }
+
+    // The Timeout of a count of primes that had covered everything up to `covered`
+    template <typename Count, typename Int>
+    Timeout counted(const Count& count, const Int& covered, const Int& last) const {
+        std::ostringstream msg;
+        msg << "counted " << count << " primes up to " << covered;
+        if (count != Count(0)) msg << ", the last " << last;
+        return Timeout(msg.str());
+    }
+
+    // Numbers per chunk for the Miller-Rabin engines: whole turns of the wheel, so every
+    // chunk holds the same 84 * 48 = 4032 candidates
+    static constexpr uint64_t TEST_SPAN = 84 * Wheel::MODULUS;
+
+    // Calls fn(BigInt<W>()) for the narrowest W of 128, 256, ..., 4096 that holds `bits` bits,
+    // so mid-size values run on small objects and short loops
+    template <typename Fn>
+    static auto with_width(size_t bits, Fn&& fn) -> decltype(fn(BigInt4096())) {
+        if (bits <= 128) return fn(BigInt<128>());
+        if (bits <= 256) return fn(BigInt<256>());
+        if (bits <= 512) return fn(BigInt<512>());
+        if (bits <= 1024) return fn(BigInt<1024>());
+        if (bits <= 2048) return fn(BigInt<2048>());
+        return fn(BigInt4096());
+    }
+
+    // Candidates per isPrimeBatch() call: enough trial-division survivors to fill the
+    // lanes several times over, few enough that a cancel is noticed soon
+    static constexpr size_t PRIME_BATCH = 512;
+
+    // The base-2 round for batches of sieved candidates on the selected device: one survivor
+    // flag per candidate back, which the CPU then confirms
+    template <size_t Bits>
+    typename BigInt<Bits>::Base2Batch base2_backend() const { return base2.batch<Bits>(); }
+
+    // Appends the primes among batch to block, in order, and empties batch; then polls the
+    // deadline, as a batch is the unit of work of the Miller-Rabin engines
+    template <size_t Bits>
+    void take_primes(std::vector<BigInt<Bits>>& batch, PrimeArena<Bits>& block) {
+        std::vector<bool> prime =
+            BigInt<Bits>::isPrimeBatch(batch, primality, rounds, BigInt<Bits>::TRIAL_PRIMES, base2_backend<Bits>());
+        for (size_t i = 0; i < batch.size(); ++i)
+            if (prime[i]) block.push(batch[i]);
+        batch.clear();
+        deadline.poll();
+    }
+
+    static uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t m) {
+        return (uint64_t)((__uint128_t)a * b % m);
+    }
+
+    static uint64_t pow_mod(uint64_t base, uint64_t exp, uint64_t m) {
+        Stats::add(Stats::ModExp);
+        Stats::add(Stats::ModSqr, 64 - __builtin_clzll(exp | 1));
+        Stats::add(Stats::ModMul, __builtin_popcountll(exp));
+        uint64_t result = 1;
+        base %= m;
+        while (exp) {
+            if (exp & 1) result = mul_mod(result, base, m);
+            exp >>= 1;
+            base = mul_mod(base, base, m);
+        }
+        return result;
+    }
+
+    // Deterministic Miller-Rabin: the first 12 prime bases are exact for every n < 2^64
+    bool is_prime(uint64_t num) {
+        static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+        Stats::add(Stats::Tested);
+        if (num < 2) {
+            Stats::add(Stats::TrialRejected);
+            return false;
+        }
+        for (uint64_t p : bases)
+            if (num % p == 0) {
+                if (num != p) Stats::add(Stats::TrialRejected);
+                return num == p;
+            }
+        uint64_t d = num - 1;
+        int r = __builtin_ctzll(d);
+        d >>= r;
+        for (uint64_t a : bases) {
+            uint64_t x = pow_mod(a, d, num);
+            if (x == 1 || x == num - 1) continue;
+            bool passed = false;
+            for (int j = 1; j < r; ++j) {
+                x = mul_mod(x, x, num);
+                Stats::add(Stats::ModSqr);
+                if (x == num - 1) {
+                    passed = true;
+                    break;
+                }
+            }
+            if (!passed) {
+                Stats::add(a == 2 ? Stats::Base2Rejected : Stats::RoundsRejected);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The largest prime up to x, or 0 below 2
+    uint64_t prime_at_most(uint64_t x) {
+        if (x < Wheel::FIRST) {
+            uint64_t largest = 0;
+            for (uint32_t p : Wheel::PRIMES)
+                if (p <= x) largest = p;
+            return largest;
+        }
+        // FIRST is prime, so the walk ends there at the latest
+        for (Wheel::Iterator<uint64_t> it(x, Wheel::Direction::Down);; ++it)
+            if (is_prime(*it)) return *it;
+    }
+
+    // The primes in [lo, hi] of the chunk [low, low + TEST_SPAN), in order, for a multiple
+    // low of TEST_SPAN. The candidates are the chunk's wheel numbers, after the wheel
+    // primes in the chunk at 0.
+    template <typename Int>
+    PrimeArena<Int::BITS> chunk_primes(const Int& low, const Int& lo, const Int& hi) {
+        std::vector<Int> batch;
+        PrimeArena<Int::BITS> block;
+        Int high = low + Int(TEST_SPAN);
+        Int from = std::max(low, lo);
+        if (low == Int(0)) {
+            for (uint32_t p : Wheel::PRIMES)
+                if (Int(p) >= lo && Int(p) <= hi) block.push(Int(p));
+            from = std::max(from, Int(Wheel::FIRST));
+        }
+        for (Wheel::Iterator<Int> it(from, Wheel::Direction::Up); *it < high && *it <= hi && !deadline.stopped(); ++it) {
+            batch.push_back(*it);
+            if (batch.size() == PRIME_BATCH) take_primes(batch, block);
+        }
+        if (!deadline.stopped()) take_primes(batch, block);
+        return block;
+    }
+
+    // Runs produce(i) for chunks i = 0, 1, ... on the pool, keeping at most two chunks per
+    // worker in flight, and hands each result to consume(i, result) in chunk order.
+    // Stops at `chunks` or as soon as consume returns false. The workers run under the
+    // task's deadline; a consumer that meets a stopped deadline should drop the result,
+    // which may have been cut short.
+    template <typename Produce, typename Consume>
+    void run_ordered(uint64_t chunks, Produce produce, Consume consume) {
+        using Result = decltype(produce(uint64_t(0)));
+        std::deque<std::future<Result>> inflight;
+        uint64_t submitted = 0, consumed = 0;
+        size_t window = 2 * pool.size();
+        while (true) {
+            while (submitted < chunks && inflight.size() < window) {
+                uint64_t i = submitted++;
+                inflight.push_back(pool.submit([this, &produce, i] {
+                    Deadline::Scope scope(deadline);
+                    return produce(i);
+                }));
+            }
+            if (inflight.empty()) return;
+            Result result = inflight.front().get();
+            inflight.pop_front();
+            if (!consume(consumed++, std::move(result))) {
+                // Stop the chunks still running, then let whatever comes next run again
+                deadline.cancel();
+                for (auto& f : inflight) f.wait();
+                deadline.resume();
+                return;
+            }
+        }
+    }
+
+    // Sieving primes up to sqrt(limit). The largest table built so far is kept and shared,
+    // since any table that reaches sqrt(limit) serves a smaller limit too. It grows at least
+    // fourfold in limit, so callers asking chunk by chunk rebuild it only a few times.
+    static std::shared_ptr<const std::vector<uint32_t>> sieving_primes(uint64_t limit) {
+        static std::mutex mutex;
+        static std::shared_ptr<const std::vector<uint32_t>> shared;
+        static uint64_t covered = 0;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!shared || covered < limit) {
+            limit = covered > UINT64_MAX / 4 ? UINT64_MAX : std::max(limit, covered * 4);
+            shared = std::make_shared<const std::vector<uint32_t>>(SegmentedSieve::sievingPrimes(limit));
+            covered = limit;
+        }
+        return shared;
+    }
+
+    // Chunk width for sieving [0, n]: at least one segment, at most four, and small enough
+    // that every worker gets several chunks
+    uint64_t sieve_chunk_span(uint64_t n) const {
+        uint64_t span = n / (8 * pool.size()) + 1;
+        span = std::min<uint64_t>(span, 4 * SegmentedSieve::SEGMENT_SPAN);
+        span = std::max<uint64_t>(span, SegmentedSieve::SEGMENT_SPAN);
+        // Whole segments, so chunk boundaries stay on the grid PrimeCache checkpoints use
+        return span - span % SegmentedSieve::SEGMENT_SPAN;
+    }
+
+    template <typename Int>
+    Int compute_nth_prime(const Int& n) {
+        Int count(0), found(0), covered(1), last(0);
+        run_ordered(UINT64_MAX,
+            [&](uint64_t i) { return chunk_primes(Int(i) * Int(TEST_SPAN), Int(0), ~Int(0)); },
+            [&](uint64_t i, PrimeArena<Int::BITS> block) {
+                if (deadline.poll()) return false;
+                block.forEach([&](const auto& p) {
+                    if (++count == n) found = p.value();
+                });
+                if (found != Int(0)) return false;
+                if (!block.empty()) last = block.back().value();
+                covered = Int(i + 1) * Int(TEST_SPAN) - 1;
+                return true;
+            });
+        if (found == Int(0) && deadline.expired()) throw counted(count, covered, last);
+        return found;
+    }
+
+    // Below this index, or inside the checkpoint prefix, sieving up to p_n beats counting
+    static constexpr uint64_t COUNT_NTH_THRESHOLD = 1 << 20;
+
+    uint64_t native_nth_prime(uint64_t n) {
+        if (n < COUNT_NTH_THRESHOLD || cache.covers(n)) return sieve_nth_prime(n);
+        return count_nth_prime(n);
+    }
+
+    // Counts the primes up to an estimate of p_n, then sieves the short way from there to p_n.
+    // The count and the answer are left in the cache as anchors, and an anchor close enough
+    // below p_n stands in for the count.
+    uint64_t count_nth_prime(uint64_t n) {
+        double ln = std::log((double)n);
+        uint64_t limit = (uint64_t)(n * (ln + std::log(ln))) + 1;
+        uint64_t x = std::min(PrimeCounter::nthPrimeEstimate(n), limit);
+        PrimeCache::Anchor near = cache.anchorBelow(n);
+        uint64_t count;
+        // Sieving on from the anchor costs about its distance to p_n, counting about x^(3/4)
+        if (near.count && (double)(n - near.count) * std::log((double)x) <= std::pow((double)x, 0.75)) {
+            x = near.x;
+            count = near.count;
+        } else {
+            count = PrimeCounter::pi(x);
+            if (deadline.expired()) throw Timeout("the count of primes up to " + std::to_string(x) + " did not finish");
+            cache.anchor(x, count);
+        }
+        uint64_t result;
+        try {
+            result = nth_prime_from(n, x, count, limit);
+        } catch (const Timeout&) {
+            // The count is worth keeping even if the sieve after it ran out of time
+            if (!cache.save()) cache_failed = true;
+            throw;
+        }
+        cache.anchor(result - 1, n - 1);
+        if (!cache.save()) cache_failed = true;
+        return result;
+    }
+
+    // p_n from count = pi(x), sieving up from x or back down from it, p_n <= limit
+    uint64_t nth_prime_from(uint64_t n, uint64_t x, uint64_t count, uint64_t limit) {
+        auto base_set = sieving_primes(limit);
+        const std::vector<uint32_t>& base = *base_set;
+        if (count < n) {
+            uint64_t result = 0, last = 0;
+            SegmentedSieve sieve(x + 1, limit, base);
+            while (!result && !deadline.poll() && sieve.nextSegment([&](uint64_t p) {
+                if (result) return;
+                last = p;
+                if (++count == n) result = p;
+            })) {}
+            if (!result && deadline.expired()) throw counted(count, last ? last : x, last);
+            return result;
+        }
+        // The estimate overshot: step back a segment at a time until the count drops below n
+        std::vector<uint64_t> window;
+        for (uint64_t high = x;; high -= SegmentedSieve::SEGMENT_SPAN) {
+            // count is pi(high) here, but the last prime at or below high is not known yet
+            if (deadline.poll())
+                throw Timeout("counted " + std::to_string(count) + " primes up to " + std::to_string(high));
+            uint64_t low = high < SegmentedSieve::SEGMENT_SPAN ? 0 : high - SegmentedSieve::SEGMENT_SPAN + 1;
+            window.clear();
+            SegmentedSieve sieve(low, high, base);
+            while (sieve.nextSegment([&](uint64_t p) { window.push_back(p); })) {}
+            if (count - window.size() < n) return window[n - (count - window.size()) - 1];
+            count -= window.size();
+        }
+    }
+
+    uint64_t sieve_nth_prime(uint64_t n) {
+        if (n == 0) return 0;
+        // Rosser's bound p_n < n (ln n + ln ln n) for n >= 6 caps the range to sieve
+        double ln = std::log((double)n);
+        uint64_t limit = n < 6 ? 13 : (uint64_t)(n * (ln + std::log(ln))) + 1;
+        auto base_set = sieving_primes(limit);
+        const std::vector<uint32_t>& base = *base_set;
+        const uint64_t segment = PrimeCache::SPAN;
+        // Resume from the last cached checkpoint below the answer
+        uint64_t k = cache.checkpointBelow(n);
+        uint64_t from = k * segment;
+        uint64_t count = cache.primesBelow(k);
+        uint64_t target = UINT64_MAX;
+        if (cache.covers(n)) {
+            // The next checkpoint is past the answer, so it lies in this one segment
+            target = from;
+        } else {
+            uint64_t span = sieve_chunk_span(limit - from);
+            auto chunk_high = [&](uint64_t low) { return limit - low < span ? limit : low + span - 1; };
+            uint64_t covered = from ? from - 1 : 0;
+            run_ordered((limit - from) / span + 1,
+                [&](uint64_t i) {
+                    // Primes per segment, so every full segment can become a checkpoint
+                    std::vector<uint64_t> found;
+                    SegmentedSieve sieve(from + i * span, chunk_high(from + i * span), base);
+                    for (bool more = true; more && !deadline.poll();) {
+                        uint64_t c = 0;
+                        more = sieve.nextSegment([&](uint64_t) { ++c; });
+                        found.push_back(c);
+                    }
+                    return found;
+                },
+                [&](uint64_t i, std::vector<uint64_t> found) {
+                    if (deadline.poll()) return false;
+                    uint64_t low = from + i * span;
+                    for (size_t j = 0; j < found.size(); ++j) {
+                        uint64_t seg_low = low + j * segment;
+                        if (count + found[j] >= n) {
+                            target = seg_low;
+                            return false;
+                        }
+                        count += found[j];
+                        if (chunk_high(low) - seg_low >= segment - 1 && seg_low / segment + 1 == cache.size())
+                            cache.extend(found[j]);
+                    }
+                    covered = chunk_high(low);
+                    return true;
+                });
+            // The checkpoints gathered before a timeout are kept too
+            if (!cache.save()) cache_failed = true;
+            if (target == UINT64_MAX && deadline.expired()) throw counted(count, covered, prime_at_most(covered));
+        }
+        if (target == UINT64_MAX) return 0;
+        // Re-sieve the segment that holds the answer and pick it out
+        uint64_t result = 0;
+        SegmentedSieve sieve(target, std::min(limit, target + segment - 1), base);
+        while (!result && sieve.nextSegment([&](uint64_t p) {
+            if (!result && ++count == n) result = p;
+        })) {}
+        return result;
+    }
+
+    // First prime among sieve survivors, in order, or 0 if there is none
+    uint64_t first_prime(const std::vector<uint64_t>& survivors) {
+        Stats::Timer timer(Stats::MillerRabin);
+        for (uint64_t candidate : survivors)
+            if (is_prime(candidate)) return candidate;
+        return 0;
+    }
+
+    // Wide candidates take the base-2 round a group of BigInt::BATCH_LANES survivors at a
+    // time (on the pool when there is one), consumed in order; the first survivor that
+    // passes then gets the remaining rounds
+    template <size_t Bits>
+    BigInt<Bits> first_prime(const std::vector<BigInt<Bits>>& survivors) {
+        using Int = BigInt<Bits>;
+        constexpr size_t LANES = Int::BATCH_LANES;
+        if (pool.size() == 1) {
+            for (size_t from = 0; from < survivors.size(); from += LANES) {
+                std::vector<Int> group(survivors.begin() + from,
+                                       survivors.begin() + std::min(from + LANES, survivors.size()));
+                std::vector<bool> prime = Int::isPrimeBatch(group, primality, rounds, 0, base2_backend<Bits>());
+                for (size_t j = 0; j < group.size(); ++j)
+                    if (prime[j]) return group[j];
+            }
+            return Int(0);
+        }
+        for (size_t next = 0; next < survivors.size();) {
+            size_t hit = survivors.size();
+            size_t groups = (survivors.size() - next + LANES - 1) / LANES;
+            run_ordered(groups,
+                [&](uint64_t g) {
+                    // Bit j set when survivor next + g * LANES + j passed
+                    uint32_t mask = 0;
+                    if (deadline.stopped()) return mask;
+                    Stats::Timer timer(Stats::MillerRabin);
+                    size_t from = next + g * LANES, count = std::min(LANES, survivors.size() - from);
+                    bool passed[LANES];
+                    base2_backend<Bits>()(survivors.data() + from, count, passed);
+                    for (size_t j = 0; j < count; ++j) mask |= (uint32_t)passed[j] << j;
+                    Stats::add(Stats::Tested, count);
+                    Stats::add(Stats::Base2Rejected, count - __builtin_popcount(mask));
+                    return mask;
+                },
+                [&](uint64_t g, uint32_t mask) {
+                    if (!mask) return true;
+                    // Everything before it is composite; stop the groups still running after it
+                    hit = next + g * LANES + __builtin_ctz(mask);
+                    return false;
+                });
+            if (hit == survivors.size()) break;
+            if (confirm_prime(survivors[hit])) return survivors[hit];
+            next = hit + 1;
+        }
+        return BigInt<Bits>(0);
+    }
+
+    // What isPrime() runs after the base-2 round, one pool task per Miller-Rabin round
+    template <size_t Bits>
+    bool confirm_prime(const BigInt<Bits>& candidate) {
+        using Int = BigInt<Bits>;
+        Stats::Timer timer(Stats::MillerRabin);
+        size_t fixed = primality == PrimalityTest::FixedBases ? rounds
+                       : primality == PrimalityTest::Auto ? Int::deterministicBases(candidate) : 0;
+        std::vector<std::future<bool>> tasks;
+        bool prime = true;
+        if (primality == PrimalityTest::RandomBases) {
+            for (int i = 0; i < rounds; ++i)
+                tasks.push_back(pool.submit([this, &candidate] {
+                    Deadline::Scope scope(deadline);
+                    return Int::isPrime(candidate, PrimalityTest::RandomBases, 1, 0);
+                }));
+        } else if (fixed > 0 || primality == PrimalityTest::FixedBases) {
+            for (size_t i = 1; i < fixed; ++i)
+                tasks.push_back(pool.submit([this, &candidate, i] {
+                    Deadline::Scope scope(deadline);
+                    return Int::isStrongProbablePrime(candidate, Int::smallPrime(i));
+                }));
+        } else {
+            // Baillie-PSW: only the Lucas test is left
+            prime = Int::isStrongLucasProbablePrime(candidate);
+        }
+        for (auto& t : tasks) prime = t.get() && prime;
+        if (!prime) Stats::add(Stats::RoundsRejected);
+        return prime;
+    }
+
+    template <typename Int>
+    Int compute_prime_less_than(const Int& n) {
+        return search_prime(n, IncrementalSieve<Int>::Direction::Down);
+    }
+
+    template <typename Int>
+    Int compute_prime_at_least(const Int& n) {
+        if (n <= Int(2)) return Int(2);
+        return search_prime(n, IncrementalSieve<Int>::Direction::Up);
+    }
+
+    // First prime from n in the given direction, or 0 when the range runs out
+    template <typename Int>
+    Int search_prime(const Int& n, typename IncrementalSieve<Int>::Direction dir) {
+        bool down = dir == IncrementalSieve<Int>::Direction::Down;
+        IncrementalSieve<Int> sieve(n, dir);
+        std::vector<Int> survivors;
+        // The last candidate of the windows searched in full
+        Int reached = n;
+        bool searched = false;
+        while (sieve.nextWindow(survivors)) {
+            Int found = first_prime(survivors);
+            // A stop may have cut the window's tests short, and an interrupted test reads as
+            // composite, so neither a find nor a miss in that window counts
+            if (deadline.stopped() || (found == Int(0) && deadline.poll())) {
+                std::ostringstream msg;
+                if (searched)
+                    msg << "no prime from " << n << (down ? " down to " : " up to ") << reached;
+                else
+                    msg << "the first window of candidates from " << n << " did not finish";
+                throw Timeout(msg.str());
+            }
+            if (found != Int(0)) return found;
+            if (!survivors.empty()) reached = survivors.back();
+            searched = true;
+        }
+        return Int(0);
+    }
+
+    template <typename Int, typename Fn>
+    uint64_t compute_primes_in_range(const Int& lo, const Int& hi, Fn& fn) {
+        // Chunks are TEST_SPAN apart from the multiple of TEST_SPAN at or below lo
+        Int origin = lo - lo % Int(TEST_SPAN);
+        Int last_chunk = (hi - origin) / Int(TEST_SPAN);
+        Int covered = lo < Int(2) ? Int(1) : lo - 1, last(0);
+        uint64_t count = 0;
+        run_ordered(UINT64_MAX,
+            [&](uint64_t i) { return chunk_primes(origin + Int(i) * Int(TEST_SPAN), lo, hi); },
+            [&](uint64_t i, PrimeArena<Int::BITS> block) {
+                if (deadline.poll()) return false;
+                Stats::Timer timer(Stats::Output);
+                if (!block.empty()) last = block.back().value();
+                count += block.size();
+                block.drain(fn);
+                covered = std::min(origin + Int(i + 1) * Int(TEST_SPAN) - 1, hi);
+                return Int(i) < last_chunk;
+            });
+        if (covered < hi && deadline.expired()) throw counted(count, covered, last);
+        return count;
+    }
+
+    // Every survivor of the small-prime windows from lo up, tested one by one
+    template <typename Fn>
+    uint64_t search_primes_in_range(uint64_t lo, uint64_t hi, Fn& fn) {
+        IncrementalSieve<uint64_t> sieve(lo, IncrementalSieve<uint64_t>::Direction::Up);
+        std::vector<uint64_t> survivors;
+        uint64_t low = lo, last = 0, count = 0;
+        while (sieve.nextWindow(survivors)) {
+            // Each window but the last at 2^64 - 1 is WINDOW wide
+            uint64_t end = std::min(hi, UINT64_MAX - low < IncrementalSieve<uint64_t>::WINDOW - 1
+                                            ? UINT64_MAX : low + IncrementalSieve<uint64_t>::WINDOW - 1);
+            Stats::Timer timer(Stats::MillerRabin);
+            for (uint64_t p : survivors) {
+                if (p > end) break;
+                if (!is_prime(p)) continue;
+                fn(p);
+                last = p;
+                ++count;
+            }
+            if (end == hi) break;
+            if (deadline.poll()) throw counted(count, end, last);
+            low = end + 1;
+        }
+        return count;
+    }
+
+    template <typename Fn>
+    uint64_t sieve_primes_in_range(uint64_t lo, uint64_t hi, Fn& fn) {
+        // One segment per chunk, stored as 32-bit offsets from the chunk start, keeps the
+        // chunks in flight small; the primes themselves go straight on to fn
+        uint64_t span = SegmentedSieve::SEGMENT_SPAN;
+        uint64_t covered = lo ? lo - 1 : 0, last = 0, count = 0;
+        run_ordered((hi - lo) / span + 1,
+            [&](uint64_t i) {
+                std::vector<uint32_t> chunk;
+                uint64_t low = lo + i * span;
+                uint64_t high = hi - low < span ? hi : low + span - 1;
+                // Each chunk takes the table it needs: the one for the whole range can take
+                // tens of seconds to build, and the deadline is only checked between chunks
+                auto base = sieving_primes(high);
+                SegmentedSieve sieve(low, high, *base);
+                auto emit = [&](uint64_t p) { chunk.push_back((uint32_t)(p - low)); };
+                while (!deadline.poll() && sieve.nextSegment(emit)) {}
+                return chunk;
+            },
+            [&](uint64_t i, std::vector<uint32_t> chunk) {
+                if (deadline.poll()) return false;
+                Stats::Timer timer(Stats::Output);
+                uint64_t low = lo + i * span;
+                for (uint32_t offset : chunk)
+                    fn(low + offset);
+                if (!chunk.empty()) last = low + chunk.back();
+                count += chunk.size();
+                covered = hi - low < span ? hi : low + span - 1;
+                return true;
+            });
+        if (covered < hi && deadline.expired()) throw counted(count, covered, last);
+        return count;
+    }
+};
+
+inline BigInt4096 nth_prime(const BigInt4096& n, const Options& options = Options()) {
+    return Engine(options).nth_prime(n);
+}
+
+inline BigInt4096 prev_prime(const BigInt4096& n, const Options& options = Options()) {
+    return Engine(options).prev_prime(n);
+}
+
+inline BigInt4096 next_prime(const BigInt4096& n, const Options& options = Options()) {
+    return Engine(options).next_prime(n);
+}
+
+inline uint64_t count_primes(const BigInt4096& n, const Options& options = Options()) {
+    return Engine(options).count_primes(n);
+}
+
+template <typename Fn>
+uint64_t primes_in_range(const BigInt4096& lo, const BigInt4096& hi, Fn&& fn, const Options& options = Options()) {
+    return Engine(options).primes_in_range(lo, hi, fn);
+}
+
+} // namespace oprime
+
+#endif // OPRIME_HPP
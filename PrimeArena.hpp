@@ -0,0 +1,101 @@
+#ifndef PRIMEARENA_HPP
+#define PRIMEARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include "BigInt4096.hpp"
+
+// -----------------------------------
+// PrimeArena<Bits>: an append-only run of BigInt<Bits> primes kept as their
+// significant words only, packed back to back in chunks that double in size
+// up to CHUNK_MAX_WORDS. A chunk holds primes of one word count, so entries
+// carry no header: a 130-bit prime takes 24 bytes however wide Bits is.
+// Readers get Views into the chunks rather than copies, and drain() frees
+// each chunk as soon as its primes have been handed on.
+// -----------------------------------
+
+// One prime in a PrimeArena<Bits>, valid until its chunk is drained or the arena is gone
+template <size_t Bits>
+class PrimeView {
+public:
+    PrimeView(const uint64_t* words, size_t used) : w(words), n(used) {}
+    const uint64_t* words() const { return w; }
+    size_t wordCount() const { return n; }
+    BigInt<Bits> value() const { return BigInt<Bits>::fromWords(w, n); }
+
+private:
+    const uint64_t* w;
+    size_t n;
+};
+
+template <size_t Bits>
+class PrimeArena {
+public:
+    static constexpr size_t CHUNK_MIN_WORDS = 64;
+    static constexpr size_t CHUNK_MAX_WORDS = 1 << 16;
+
+    using View = PrimeView<Bits>;
+
+    void push(const BigInt<Bits>& p) {
+        size_t used = p.wordCount();
+        if (chunks.empty() || chunks.back().width != used || chunks.back().full())
+            grow(used);
+        Chunk& c = chunks.back();
+        std::copy(p.words(), p.words() + used, c.words.get() + c.count * used);
+        ++c.count;
+        ++total;
+    }
+
+    size_t size() const { return total; }
+    bool empty() const { return total == 0; }
+
+    // The newest prime; the arena must not be empty
+    View back() const {
+        const Chunk& c = chunks.back();
+        return View(c.words.get() + (c.count - 1) * c.width, c.width);
+    }
+
+    // fn(View) for every prime, oldest first
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Chunk& c : chunks)
+            for (size_t i = 0; i < c.count; ++i) fn(View(c.words.get() + i * c.width, c.width));
+    }
+
+    // forEach(), releasing each chunk once fn has seen all of its primes; leaves the arena empty
+    template <typename Fn>
+    void drain(Fn&& fn) {
+        while (!chunks.empty()) {
+            const Chunk& c = chunks.front();
+            for (size_t i = 0; i < c.count; ++i) fn(View(c.words.get() + i * c.width, c.width));
+            total -= c.count;
+            chunks.pop_front();
+        }
+        nextWords = CHUNK_MIN_WORDS;
+    }
+
+private:
+    struct Chunk {
+        std::unique_ptr<uint64_t[]> words;
+        size_t width;    // Words per prime
+        size_t capacity; // Primes the chunk can hold
+        size_t count = 0;
+        bool full() const { return count == capacity; }
+    };
+
+    std::deque<Chunk> chunks;
+    size_t total = 0;
+    size_t nextWords = CHUNK_MIN_WORDS;
+
+    void grow(size_t width) {
+        size_t capacity = std::max<size_t>(1, nextWords / width);
+        // Left uninitialized: only the words below count * width are ever read
+        chunks.push_back({std::unique_ptr<uint64_t[]>(new uint64_t[capacity * width]), width, capacity});
+        nextWords = std::min(2 * nextWords, CHUNK_MAX_WORDS);
+    }
+};
+
+#endif // PRIMEARENA_HPP
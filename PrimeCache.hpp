@@ -0,0 +1,162 @@
+#ifndef PRIMECACHE_HPP
+#define PRIMECACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "SegmentedSieve.hpp"
+
+// -----------------------------------
+// PrimeCache: on-disk prime-counting checkpoints shared by nth-prime runs.
+// Entry k holds pi(k * SEGMENT_SPAN - 1), the number of primes below the k-th
+// segment boundary, so a query skips every segment the cache already covers and
+// sieves on from the last checkpoint below its answer. Checkpoints sit on the
+// sieve's own segment grid and runs only ever extend the covered prefix, so one
+// flat array of counts describes everything learned so far.
+//
+// Past that prefix, queries answered by counting leave anchors: isolated pairs
+// (x, pi(x)) off the grid, from the count at the estimate and from the answer
+// itself. A later query near one sieves on from it instead of counting again.
+//
+// File: 8-byte magic, the segment span, the entry and anchor counts, the
+// entries, then the anchors as (x, pi(x)) pairs (native uint64_t each). A file
+// with another magic or span is ignored.
+// -----------------------------------
+class PrimeCache {
+public:
+    static constexpr uint64_t SPAN = SegmentedSieve::SEGMENT_SPAN;
+
+    // pi(x) = count
+    struct Anchor {
+        uint64_t x;
+        uint64_t count;
+    };
+
+    // An empty directory name gives a cache that is never read or written
+    explicit PrimeCache(const std::string& dir) : path(dir.empty() ? "" : dir + "/nth_prime.cache") {
+        Contents file = load(path);
+        counts = std::move(file.counts);
+        anchors = std::move(file.anchors);
+        stored = counts.size();
+        storedAnchors = anchors.size();
+        if (counts.empty()) counts.push_back(0);
+    }
+
+    // Highest checkpoint k with pi(k * SPAN - 1) < n: the n-th prime is at least k * SPAN
+    uint64_t checkpointBelow(uint64_t n) const {
+        return std::lower_bound(counts.begin(), counts.end(), n) - counts.begin() - 1;
+    }
+
+    // True when a checkpoint past the n-th prime is known, so it lies in a single cached segment
+    bool covers(uint64_t n) const { return checkpointBelow(n) + 1 < counts.size(); }
+
+    // Checkpoints known, counting the one at 0
+    uint64_t size() const { return counts.size(); }
+
+    // Primes below k * SPAN; k must be below size()
+    uint64_t primesBelow(uint64_t k) const { return counts[k]; }
+
+    // Records `primes` primes in segment size() - 1, adding the checkpoint after it
+    void extend(uint64_t primes) { counts.push_back(counts.back() + primes); }
+
+    // The anchor with the most primes below n, so the n-th prime lies past its x; {0, 0} if none
+    Anchor anchorBelow(uint64_t n) const {
+        auto it = std::lower_bound(anchors.begin(), anchors.end(), n,
+                                   [](const Anchor& a, uint64_t v) { return a.count < v; });
+        return it == anchors.begin() ? Anchor{0, 0} : *(it - 1);
+    }
+
+    // Records pi(x) = count
+    void anchor(uint64_t x, uint64_t count) { insert(anchors, Anchor{x, count}); }
+
+    // Writes what this run learned back, merged with what other runs saved meanwhile
+    bool save() {
+        if (path.empty() || (counts.size() <= stored && anchors.size() <= storedAnchors)) return true;
+        Contents file = load(path);
+        for (const Anchor& a : file.anchors) insert(anchors, a);
+        // Of two checkpoint prefixes the longer one holds the other
+        if (file.counts.size() > counts.size()) counts = std::move(file.counts);
+        if (file.counts.size() >= counts.size() && file.anchors.size() >= anchors.size()) {
+            stored = counts.size();
+            storedAnchors = anchors.size();
+            return true;
+        }
+        // Written aside and renamed so concurrent readers never see a partial file. Engines in
+        // one process share a pid, so a per-process counter keeps their files apart.
+        static std::atomic<uint64_t> saves{0};
+        std::string tmp = path + "." + std::to_string(::getpid()) + "." + std::to_string(saves++);
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        uint64_t head[3] = {SPAN, counts.size(), anchors.size()};
+        bool ok = std::fwrite(MAGIC, 1, sizeof MAGIC, f) == sizeof MAGIC
+                  && std::fwrite(head, sizeof head, 1, f) == 1
+                  && std::fwrite(counts.data(), sizeof(uint64_t), counts.size(), f) == counts.size()
+                  && std::fwrite(anchors.data(), sizeof(Anchor), anchors.size(), f) == anchors.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (ok) ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+        if (!ok) {
+            std::remove(tmp.c_str());
+        } else {
+            stored = counts.size();
+            storedAnchors = anchors.size();
+        }
+        return ok;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'O', 'P', 'C', 'A', 'C', 'H', 'E', '2'};
+
+    struct Contents {
+        std::vector<uint64_t> counts;
+        std::vector<Anchor> anchors;
+    };
+
+    std::string path;
+    std::vector<uint64_t> counts;
+    // Sorted by x, and so by count
+    std::vector<Anchor> anchors;
+    // Entries and anchors already in the file when it was last read or written
+    size_t stored = 0;
+    size_t storedAnchors = 0;
+
+    static void insert(std::vector<Anchor>& to, const Anchor& a) {
+        auto it = std::lower_bound(to.begin(), to.end(), a.x, [](const Anchor& b, uint64_t x) { return b.x < x; });
+        if (it == to.end() || it->x != a.x) to.insert(it, a);
+    }
+
+    static Contents load(const std::string& path) {
+        Contents out;
+        if (path.empty()) return out;
+        std::FILE* f = std::fopen(path.c_str(), "rb");
+        if (!f) return out;
+        char magic[sizeof MAGIC];
+        uint64_t head[3];
+        if (std::fread(magic, 1, sizeof magic, f) == sizeof magic && std::memcmp(magic, MAGIC, sizeof MAGIC) == 0
+            && std::fread(head, sizeof head, 1, f) == 1 && head[0] == SPAN) {
+            long start = std::ftell(f);
+            std::fseek(f, 0, SEEK_END);
+            uint64_t words = (std::ftell(f) - start) / sizeof(uint64_t);
+            std::fseek(f, start, SEEK_SET);
+            if (head[1] <= words && head[2] <= (words - head[1]) / 2) {
+                out.counts.resize(head[1]);
+                out.anchors.resize(head[2]);
+            }
+            bool ok = std::fread(out.counts.data(), sizeof(uint64_t), out.counts.size(), f) == out.counts.size()
+                      && std::fread(out.anchors.data(), sizeof(Anchor), out.anchors.size(), f) == out.anchors.size()
+                      && (out.counts.empty() || out.counts[0] == 0);
+            // Anchors must be strictly increasing in x and never decreasing in count
+            for (size_t i = 1; ok && i < out.anchors.size(); ++i)
+                ok = out.anchors[i - 1].x < out.anchors[i].x && out.anchors[i - 1].count <= out.anchors[i].count;
+            if (!ok) out = Contents();
+        }
+        std::fclose(f);
+        return out;
+    }
+};
+
+#endif // PRIMECACHE_HPP
@@ -0,0 +1,105 @@
+#ifndef PRIMECOUNT_HPP
+#define PRIMECOUNT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "Deadline.hpp"
+#include "Stats.hpp"
+
+// -----------------------------------
+// PrimeCounter: pi(x) without enumerating the primes, by Lucy_Hedgehog's
+// method. It tracks S(v) = #{ n in [2, v] surviving sieving by primes < p } for
+// the O(sqrt x) distinct values v = floor(x / i), and sieving by p updates
+// S(v) -= S(v / p) - S(p - 1) for every v >= p^2. The work is
+// O(x^(3/4) / log x) and the memory is two arrays of sqrt(x) counts: pi(10^12)
+// takes under two seconds and 16 MB. Every Deadline::POLL_WORK updates it
+// polls Deadline::interrupted(), and pi() returns 0 once that reports a stop.
+// -----------------------------------
+class PrimeCounter {
+public:
+    static uint64_t pi(uint64_t x) {
+        if (x < 2) return 0;
+        Stats::Timer timer(Stats::Count);
+        uint64_t r = isqrt(x);
+        // small[v] tracks S(v) for v <= r, large[i] tracks S(x / i) for i <= r
+        std::vector<uint64_t> small(r + 1), large(r + 1);
+        for (uint64_t v = 1; v <= r; ++v) small[v] = v - 1;
+        uint64_t work = 0;
+        if (!sweep(r, work, [&](uint64_t t) { large[t + 1] = x / (t + 1) - 1; })) return 0;
+        for (uint64_t p = 2; p <= r; ++p) {
+            if (small[p] == small[p - 1]) continue; // p is composite
+            uint64_t sp = small[p - 1];
+            uint64_t p2 = p * p;
+            // Ascending i and descending v read only entries this p has not touched yet
+            uint64_t iend = std::min(r, x / p2);
+            if (!sweep(iend, work, [&](uint64_t t) {
+                    uint64_t i = t + 1, ip = i * p;
+                    large[i] -= (ip <= r ? large[ip] : small[x / ip]) - sp;
+                }))
+                return 0;
+            if (p2 <= r && !sweep(r - p2 + 1, work, [&](uint64_t t) {
+                    uint64_t v = r - t;
+                    small[v] -= small[v / p] - sp;
+                }))
+                return 0;
+        }
+        return large[1];
+    }
+
+    // li^-1(n) by Newton's method: within O(sqrt(p_n) log p_n) of the n-th prime
+    static uint64_t nthPrimeEstimate(uint64_t n) {
+        if (n < 6) return 13;
+        long double target = n;
+        long double x = target * std::log(target);
+        for (int i = 0; i < 64; ++i) {
+            long double step = (li(x) - target) * std::log(x);
+            x -= step;
+            if (std::fabs(step) < 0.5L) break;
+        }
+        return (uint64_t)x;
+    }
+
+private:
+    // fn(t) for t = 0, 1, ..., count - 1, polling Deadline::interrupted() each time the
+    // running total `work` reaches Deadline::POLL_WORK; false once that reports a stop
+    template <typename Fn>
+    static bool sweep(uint64_t count, uint64_t& work, Fn&& fn) {
+        for (uint64_t t = 0; t < count;) {
+            uint64_t block = std::min(count - t, Deadline::POLL_WORK - work);
+            for (uint64_t end = t + block; t < end; ++t) fn(t);
+            work += block;
+            if (work == Deadline::POLL_WORK) {
+                if (Deadline::interrupted()) return false;
+                work = 0;
+            }
+        }
+        return true;
+    }
+
+    static uint64_t isqrt(uint64_t n) {
+        uint64_t r = (uint64_t)std::sqrt((long double)n);
+        while (r > 0 && (__uint128_t)r * r > n) --r;
+        while ((__uint128_t)(r + 1) * (r + 1) <= n) ++r;
+        return r;
+    }
+
+    // Logarithmic integral by Ramanujan's series:
+    //   li(x) = gamma + ln ln x + sqrt(x) sum_{n>=1} (-1)^(n-1) (ln x)^n / (n! 2^(n-1)) sum_{k<=(n-1)/2} 1/(2k+1)
+    static long double li(long double x) {
+        const long double gamma = 0.57721566490153286060651209L;
+        long double lnx = std::log(x);
+        long double sum = 0, power = 1, inner = 0;
+        for (int n = 1; n < 200; ++n) {
+            power *= lnx / (n > 1 ? 2 * n : 1);
+            if (n & 1) inner += 1.0L / n;
+            long double t = (n & 1 ? power : -power) * inner;
+            sum += t;
+            if (std::fabs(t) < 1e-20L * std::fabs(sum)) break;
+        }
+        return gamma + std::log(lnx) + std::sqrt(x) * sum;
+    }
+};
+
+#endif // PRIMECOUNT_HPP
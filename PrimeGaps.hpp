@@ -0,0 +1,219 @@
+#ifndef PRIMEGAPS_HPP
+#define PRIMEGAPS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// -----------------------------------
+// Prime-gap file format (--format=gaps)
+//
+//   header   GapFormat::Header, 64 bytes
+//   blocks   for each run of BLOCK_PRIMES primes, the gaps after its first prime
+//   index    for each block, its first prime and the file offset of its gaps,
+//            starting at the next 8-byte boundary
+//
+// Gaps are LEB128 varints of gap / 2; every gap is even except 2 -> 3, which is
+// stored as 0. Below 10^12 almost every gap fits in one byte, against 13 for a
+// line of text. All integers are little-endian.
+// -----------------------------------
+struct GapFormat {
+    static constexpr char MAGIC[8] = {'O', 'P', 'G', 'A', 'P', 'S', '0', '1'};
+    static constexpr uint32_t BLOCK_PRIMES = 1 << 16;
+
+    struct Header {
+        char magic[8];
+        uint32_t blockPrimes;
+        uint32_t reserved;
+        uint64_t count;
+        uint64_t lastPrime;
+        uint64_t blocks;
+        uint64_t indexOffset;
+        uint64_t padding[2];
+    };
+
+    struct BlockEntry {
+        uint64_t firstPrime;
+        uint64_t offset;
+    };
+
+    // Writes the code for one gap at out and returns the end of it; needs up to 10 bytes
+    static uint8_t* encodeGap(uint8_t* out, uint64_t gap) {
+        uint64_t v = gap >> 1;
+        while (v >= 0x80) {
+            *out++ = (uint8_t)(v | 0x80);
+            v >>= 7;
+        }
+        *out++ = (uint8_t)v;
+        return out;
+    }
+
+    // Reads one gap code at in, advancing it, but not past end: a code cut short there
+    // reads as what it holds so far
+    static uint64_t decodeGap(const uint8_t*& in, const uint8_t* end) {
+        uint64_t v = 0;
+        for (int shift = 0; in < end && shift < 64; shift += 7) {
+            uint8_t b = *in++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+        return v ? 2 * v : 1;
+    }
+};
+static_assert(sizeof(GapFormat::Header) == 64, "the header layout is part of the file format");
+
+// -----------------------------------
+// GapReader: read-only view of a gap file through mmap.
+// Opening maps the file and validates the header and every index entry, and
+// decoding never reads past the end of a block's gaps, so a truncated or
+// corrupt file gives wrong primes at worst, never a read outside the mapping.
+// Lookups by index decode at most one block, and lookups by value
+// binary-search the block index first.
+// -----------------------------------
+class GapReader {
+public:
+    GapReader() = default;
+    explicit GapReader(const std::string& filename) { open(filename); }
+    ~GapReader() { close(); }
+
+    GapReader(const GapReader&) = delete;
+    GapReader& operator=(const GapReader&) = delete;
+
+    // Maps the file; false if it is missing or not a well-formed gap file
+    bool open(const std::string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(GapFormat::Header)) {
+            void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p != MAP_FAILED) {
+                base = static_cast<const uint8_t*>(p);
+                length = st.st_size;
+            }
+        }
+        ::close(fd);
+        if (!base) return false;
+        std::memcpy(&header, base, sizeof header);
+        bool valid = std::memcmp(header.magic, GapFormat::MAGIC, sizeof GapFormat::MAGIC) == 0 && header.blockPrimes > 0
+                     && header.blocks == (header.count + header.blockPrimes - 1) / header.blockPrimes
+                     && header.indexOffset % alignof(GapFormat::BlockEntry) == 0 && header.indexOffset <= length
+                     && (length - header.indexOffset) / sizeof(GapFormat::BlockEntry) >= header.blocks;
+        if (valid) {
+            index = reinterpret_cast<const GapFormat::BlockEntry*>(base + header.indexOffset);
+            // Each block's gaps start after the header and the previous block's, and end by the index
+            uint64_t from = sizeof(GapFormat::Header);
+            for (uint64_t b = 0; valid && b < header.blocks; ++b) {
+                valid = index[b].offset >= from && index[b].offset <= header.indexOffset
+                        && (b == 0 || index[b].firstPrime > index[b - 1].firstPrime)
+                        && index[b].firstPrime <= header.lastPrime;
+                from = index[b].offset;
+            }
+        }
+        if (!valid) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (base) ::munmap(const_cast<uint8_t*>(base), length);
+        base = nullptr;
+        index = nullptr;
+        length = 0;
+        header = GapFormat::Header{};
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    // Number of primes in the file
+    uint64_t size() const { return header.count; }
+
+    // Largest prime in the file, or 0 if it is empty
+    uint64_t last() const { return header.lastPrime; }
+
+    // The i-th prime in the file, counting from 0; 0 when i is size() or more
+    uint64_t at(uint64_t i) const {
+        if (i >= header.count) return 0;
+        uint64_t block = i / header.blockPrimes;
+        uint64_t p = index[block].firstPrime;
+        const uint8_t* in = base + index[block].offset;
+        const uint8_t* end = blockEnd(block);
+        for (uint64_t k = i % header.blockPrimes; k > 0; --k) p += GapFormat::decodeGap(in, end);
+        return p;
+    }
+
+    // Index of the first prime >= value; size() when there is none
+    uint64_t lowerBound(uint64_t value) const {
+        // Last block whose first prime is <= value, if any
+        const GapFormat::BlockEntry* end = index + header.blocks;
+        const GapFormat::BlockEntry* e = std::upper_bound(index, end, value,
+            [](uint64_t v, const GapFormat::BlockEntry& b) { return v < b.firstPrime; });
+        if (e == index) return 0;
+        --e;
+        uint64_t block = e - index;
+        uint64_t i = block * header.blockPrimes;
+        uint64_t stop = std::min(i + header.blockPrimes, header.count);
+        uint64_t p = e->firstPrime;
+        const uint8_t* in = base + e->offset;
+        const uint8_t* stopAt = blockEnd(block);
+        while (p < value && ++i < stop) p += GapFormat::decodeGap(in, stopAt);
+        return i;
+    }
+
+    // Number of primes in the file that are <= value
+    uint64_t countUpTo(uint64_t value) const {
+        uint64_t i = lowerBound(value);
+        return i < size() && at(i) == value ? i + 1 : i;
+    }
+
+    // Calls fn(p) for every prime in [low, high], in ascending order
+    template <typename Fn>
+    void forEach(uint64_t low, uint64_t high, Fn&& fn) const {
+        uint64_t i = lowerBound(low);
+        if (i >= size()) return;
+        uint64_t p = at(i);
+        const uint8_t* in = nullptr;
+        const uint8_t* end = blockEnd(i / header.blockPrimes);
+        while (p <= high) {
+            fn(p);
+            if (++i >= size()) return;
+            if (i % header.blockPrimes == 0) {
+                p = index[i / header.blockPrimes].firstPrime;
+                in = base + index[i / header.blockPrimes].offset;
+                end = blockEnd(i / header.blockPrimes);
+            } else {
+                if (!in) in = seek(i - 1);
+                p += GapFormat::decodeGap(in, end);
+            }
+        }
+    }
+
+private:
+    const uint8_t* base = nullptr;
+    size_t length = 0;
+    GapFormat::Header header{};
+    const GapFormat::BlockEntry* index = nullptr;
+
+    // Where the gaps of a block stop: the next block's gaps, or the index after the last one
+    const uint8_t* blockEnd(uint64_t block) const {
+        return base + (block + 1 < header.blocks ? index[block + 1].offset : header.indexOffset);
+    }
+
+    // Position of the gap code that follows the i-th prime
+    const uint8_t* seek(uint64_t i) const {
+        uint64_t block = i / header.blockPrimes;
+        const uint8_t* in = base + index[block].offset;
+        const uint8_t* end = blockEnd(block);
+        for (uint64_t k = i % header.blockPrimes; k > 0; --k) GapFormat::decodeGap(in, end);
+        return in;
+    }
+};
+
+#endif // PRIMEGAPS_HPP
@@ -0,0 +1,225 @@
+#ifndef PRIMEWRITER_HPP
+#define PRIMEWRITER_HPP
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BigInt4096.hpp"
+#include "PrimeArena.hpp"
+#include "PrimeGaps.hpp"
+
+// -----------------------------------
+// PrimeWriter: streams primes to a file, one decimal per line (Text) or as
+// varint gaps (Gaps, see PrimeGaps.hpp; 64-bit primes only).
+// Output is formatted straight into a small ring of large page-aligned buffers;
+// a full buffer is handed to a background thread that write()s it out while the
+// caller keeps filling the next one. Memory stays at BUFFER_COUNT * BUFFER_BYTES
+// however many primes pass through, plus 16 bytes per block of the gap index.
+// -----------------------------------
+class PrimeWriter {
+public:
+    static constexpr size_t BUFFER_BYTES = 1 << 20;
+    static constexpr size_t BUFFER_COUNT = 4;
+
+    enum class Format { Text, Gaps };
+
+    explicit PrimeWriter(const std::string& filename, Format format = Format::Text) : format(format) {
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return;
+        for (auto& b : buffers) {
+            b.data.reset(static_cast<char*>(std::aligned_alloc(4096, BUFFER_BYTES)));
+            spare.push_back(&b);
+        }
+        current = spare.front();
+        spare.pop_front();
+        // The gap header is filled in by close(), once the totals are known
+        if (format == Format::Gaps) {
+            std::memset(current->data.get(), 0, sizeof(GapFormat::Header));
+            current->size = sizeof(GapFormat::Header);
+        }
+        writer = std::thread([this] { writerLoop(); });
+    }
+
+    ~PrimeWriter() { close(); }
+
+    PrimeWriter(const PrimeWriter&) = delete;
+    PrimeWriter& operator=(const PrimeWriter&) = delete;
+
+    // False when the file could not be opened or a write failed
+    bool ok() const { return fd >= 0 && !failed; }
+
+    // Primes accepted so far
+    uint64_t count() const { return written; }
+
+    void put(uint64_t p) {
+        if (format == Format::Gaps) {
+            putGap(p);
+            return;
+        }
+        reserve(20 + 1);
+        char* end = std::to_chars(current->data.get() + current->size, current->data.get() + BUFFER_BYTES, p).ptr;
+        *end++ = '\n';
+        current->size = end - current->data.get();
+        ++written;
+    }
+
+    template <size_t Bits>
+    void put(const BigInt<Bits>& p) {
+        if (format == Format::Gaps) {
+            if (p.bitLength() > 64) failed = true;
+            else putGap((uint64_t)p);
+            return;
+        }
+        reserve(BigInt<Bits>::MAX_DECIMAL_DIGITS + 1);
+        char* end = p.toChars(current->data.get() + current->size, current->data.get() + BUFFER_BYTES).ptr;
+        *end++ = '\n';
+        current->size = end - current->data.get();
+        ++written;
+    }
+
+    // A prime still in its arena, formatted from its words without a BigInt copy
+    template <size_t Bits>
+    void put(const PrimeView<Bits>& p) {
+        if (format == Format::Gaps) {
+            if (p.wordCount() > 1) failed = true;
+            else putGap(p.wordCount() ? p.words()[0] : 0);
+            return;
+        }
+        reserve(BigInt<Bits>::MAX_DECIMAL_DIGITS + 1);
+        char* end = BigInt<Bits>::toChars(p.words(), p.wordCount(), current->data.get() + current->size,
+                                          current->data.get() + BUFFER_BYTES).ptr;
+        *end++ = '\n';
+        current->size = end - current->data.get();
+        ++written;
+    }
+
+    // Flushes what is buffered and waits for the writer thread. Returns ok().
+    bool close() {
+        if (!writer.joinable()) return ok();
+        if (format == Format::Gaps) {
+            // The block index follows the gaps at the next 8-byte boundary
+            reserve(8);
+            while (position() % alignof(GapFormat::BlockEntry)) current->data.get()[current->size++] = 0;
+            header.indexOffset = position();
+            for (const auto& entry : index) {
+                reserve(sizeof entry);
+                std::memcpy(current->data.get() + current->size, &entry, sizeof entry);
+                current->size += sizeof entry;
+            }
+        }
+        submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        filled.notify_one();
+        writer.join();
+        if (format == Format::Gaps && !failed) {
+            std::memcpy(header.magic, GapFormat::MAGIC, sizeof header.magic);
+            header.blockPrimes = GapFormat::BLOCK_PRIMES;
+            header.count = written;
+            header.lastPrime = lastPrime;
+            header.blocks = index.size();
+            if (::pwrite(fd, &header, sizeof header, 0) != (ssize_t)sizeof header) failed = true;
+        }
+        ::close(fd);
+        return !failed;
+    }
+
+private:
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+
+    struct Buffer {
+        std::unique_ptr<char, FreeDeleter> data;
+        size_t size = 0;
+    };
+
+    Format format;
+    int fd = -1;
+    std::atomic<bool> failed{false};
+    uint64_t written = 0;
+    std::array<Buffer, BUFFER_COUNT> buffers;
+    Buffer* current = nullptr;
+    // Buffers ready to be written, and buffers ready to be filled
+    std::deque<Buffer*> full, spare;
+    std::mutex mutex;
+    std::condition_variable filled, drained;
+    bool stopping = false;
+    std::thread writer;
+    // Bytes handed to the writer thread so far
+    uint64_t flushed = 0;
+    // Gap format state
+    uint64_t lastPrime = 0;
+    std::vector<GapFormat::BlockEntry> index;
+    GapFormat::Header header{};
+
+    // File offset of the next byte to be buffered
+    uint64_t position() const { return flushed + current->size; }
+
+    void putGap(uint64_t p) {
+        reserve(10);
+        if (written % GapFormat::BLOCK_PRIMES == 0) {
+            index.push_back({p, position()});
+        } else {
+            uint8_t* out = reinterpret_cast<uint8_t*>(current->data.get() + current->size);
+            current->size = reinterpret_cast<char*>(GapFormat::encodeGap(out, p - lastPrime)) - current->data.get();
+        }
+        lastPrime = p;
+        ++written;
+    }
+
+    // Makes room for a line of up to n bytes
+    void reserve(size_t n) {
+        if (BUFFER_BYTES - current->size < n) submit();
+    }
+
+    // Queues the current buffer for writing and takes a free one
+    void submit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (current->size) {
+            flushed += current->size;
+            full.push_back(current);
+            filled.notify_one();
+            drained.wait(lock, [this] { return !spare.empty(); });
+            current = spare.front();
+            spare.pop_front();
+        }
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            filled.wait(lock, [this] { return stopping || !full.empty(); });
+            if (full.empty()) return;
+            Buffer* b = full.front();
+            full.pop_front();
+            lock.unlock();
+            for (size_t off = 0; off < b->size && !failed;) {
+                ssize_t n = ::write(fd, b->data.get() + off, b->size - off);
+                if (n >= 0) off += n;
+                else if (errno != EINTR) failed = true;
+            }
+            b->size = 0;
+            lock.lock();
+            spare.push_back(b);
+            drained.notify_one();
+        }
+    }
+};
+
+#endif // PRIMEWRITER_HPP
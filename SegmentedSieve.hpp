@@ -0,0 +1,169 @@
+#ifndef SEGMENTEDSIEVE_HPP
+#define SEGMENTEDSIEVE_HPP
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "Stats.hpp"
+
+// -----------------------------------
+// SegmentedSieve: Sieve of Eratosthenes over [low, high] in fixed-size blocks.
+// Each byte covers 30 integers and holds one bit per residue coprime to 30
+// (1, 7, 11, 13, 17, 19, 23, 29), so only 8 of every 30 numbers are stored.
+// Memory is one segment plus the sieving primes up to sqrt(high).
+// -----------------------------------
+class SegmentedSieve {
+public:
+    static constexpr size_t SEGMENT_BYTES = 128 * 1024;
+    static constexpr uint64_t SEGMENT_SPAN = SEGMENT_BYTES * 30;
+
+    SegmentedSieve(uint64_t low, uint64_t high)
+        : SegmentedSieve(low, high, sievingPrimes(high)) {}
+
+    // Sieves with a caller-owned prime table, which must include every prime up to sqrt(high).
+    // Lets the sub-ranges of one large range share a single table.
+    SegmentedSieve(uint64_t low, uint64_t high, const std::vector<uint32_t>& base)
+        : low(low), high(high), segment(SEGMENT_BYTES) {
+        if (high < 7 || low > high) {
+            byteLow = byteEnd = 0;
+            return;
+        }
+        uint64_t start = std::max<uint64_t>(low, 7);
+        byteLow = start / 30;
+        byteEnd = high / 30 + 1;
+        for (uint32_t p : base) {
+            if ((uint64_t)p * p > high) break;
+            if (p < 7) continue;
+            SievingPrime sp;
+            sp.prime = p;
+            // Multiples p*q with q >= p are in residue class k when q = k * p^-1 (mod 30)
+            uint64_t qmin = std::max<uint64_t>(p, (std::max<uint64_t>(start, 1) + p - 1) / p);
+            for (int k = 0; k < 8; ++k) {
+                uint64_t qr = 0;
+                for (int j = 0; j < 8; ++j)
+                    if ((uint64_t)p * RESIDUES[j] % 30 == RESIDUES[k]) qr = RESIDUES[j];
+                uint64_t q = qmin + (qr + 30 - qmin % 30) % 30;
+                __uint128_t m = (__uint128_t)p * q;
+                sp.next[k] = m / 30 >= byteEnd ? byteEnd : (uint64_t)(m / 30);
+            }
+            sieving.push_back(sp);
+        }
+    }
+
+    // Sieves the next block and calls emit(p) for each prime in it, in ascending order.
+    // Returns false once the whole range has been emitted.
+    template <typename Emit>
+    bool nextSegment(Emit&& emit) {
+        Stats::Timer timer(Stats::Sieve);
+        uint64_t emitted = 0;
+        if (!smallDone) {
+            smallDone = true;
+            for (uint64_t p : {2, 3, 5})
+                if (p >= low && p <= high) {
+                    emit(p);
+                    ++emitted;
+                }
+        }
+        if (byteLow >= byteEnd) return false;
+        uint64_t byteHigh = std::min<uint64_t>(byteLow + SEGMENT_BYTES, byteEnd);
+        size_t len = byteHigh - byteLow;
+        std::fill(segment.begin(), segment.begin() + len, 0);
+        for (auto& sp : sieving) {
+            for (int k = 0; k < 8; ++k) {
+                uint64_t n = sp.next[k];
+                uint8_t mask = 1 << k;
+                for (; n < byteHigh; n += sp.prime)
+                    segment[n - byteLow] |= mask;
+                sp.next[k] = n;
+            }
+        }
+        // Survivors are read eight bytes at a time: bit b of the word is residue b % 8 of byte
+        // b / 8, so one ctz walks 240 numbers and runs of composites cost nothing
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, &segment[i], 8);
+            uint64_t bits = ~word;
+            uint64_t base = (byteLow + i) * 30;
+            while (bits) {
+                int b = __builtin_ctzll(bits);
+                bits &= bits - 1;
+                uint64_t value = base + (b >> 3) * 30 + RESIDUES[b & 7];
+                // 1 is coprime to 30 but not prime; the range ends fall inside the first and last bytes
+                if (value < 7 || value < low) continue;
+                if (value > high) break;
+                emit(value);
+                ++emitted;
+            }
+        }
+        for (; i < len; ++i) {
+            uint8_t bits = ~segment[i];
+            uint64_t base = (byteLow + i) * 30;
+            while (bits) {
+                int b = __builtin_ctz(bits);
+                bits &= bits - 1;
+                uint64_t value = base + RESIDUES[b];
+                if (value < 7 || value < low) continue;
+                if (value > high) break;
+                emit(value);
+                ++emitted;
+            }
+        }
+        if (Stats::enabled()) {
+            uint64_t covered = std::min(high, byteHigh * 30 - 1) - std::max(low, byteLow * 30) + 1;
+            Stats::add(Stats::Sieved, covered);
+            Stats::add(Stats::SieveRejected, covered - emitted);
+        }
+        byteLow = byteHigh;
+        return byteLow < byteEnd;
+    }
+
+    // Every number below this has already been emitted
+    uint64_t position() const { return std::min(byteLow * 30, high); }
+
+    // The primes up to sqrt(high), as needed to sieve any range ending at high
+    static std::vector<uint32_t> sievingPrimes(uint64_t high) { return baseprimes(isqrt(high)); }
+
+private:
+    static constexpr std::array<uint8_t, 8> RESIDUES = {1, 7, 11, 13, 17, 19, 23, 29};
+
+    struct SievingPrime {
+        uint64_t prime;
+        // Next byte index to mark for each residue class
+        std::array<uint64_t, 8> next;
+    };
+
+    uint64_t low;
+    uint64_t high;
+    uint64_t byteLow;
+    uint64_t byteEnd;
+    bool smallDone = false;
+    std::vector<uint8_t> segment;
+    std::vector<SievingPrime> sieving;
+
+    static uint64_t isqrt(uint64_t n) {
+        uint64_t r = (uint64_t)std::sqrt((long double)n);
+        while (r > 0 && (__uint128_t)r * r > n) --r;
+        while ((__uint128_t)(r + 1) * (r + 1) <= n) ++r;
+        return r;
+    }
+
+    // Plain odd-only sieve for the primes up to limit
+    static std::vector<uint32_t> baseprimes(uint64_t limit) {
+        std::vector<uint32_t> out;
+        if (limit >= 2) out.push_back(2);
+        std::vector<bool> composite(limit / 2 + 1);
+        for (uint64_t i = 3; i <= limit; i += 2) {
+            if (composite[i / 2]) continue;
+            out.push_back((uint32_t)i);
+            for (uint64_t j = i * i; j <= limit; j += 2 * i)
+                composite[j / 2] = true;
+        }
+        return out;
+    }
+};
+
+#endif // SEGMENTEDSIEVE_HPP
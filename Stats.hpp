@@ -0,0 +1,177 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// -----------------------------------
+// Stats: performance counters and phase timings behind --stats. Every thread
+// adds to a block of its own, so the hot paths never share a cache line, and
+// report() sums the blocks. Until enable() each hook is one well-predicted
+// branch on a flag, and Timer does not read the clock. Loops that run many
+// products count them locally and add the total once per chain.
+// -----------------------------------
+class Stats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Counter {
+        Sieved,         // Numbers a sieve segment or window covered
+        SieveRejected,  // ... of which the sieve crossed off
+        Tested,         // Candidates given a primality test
+        TrialRejected,  // ... of which trial division ruled out
+        Base2Rejected,  // ... of which the base-2 Miller-Rabin round ruled out
+        RoundsRejected, // ... of which a later round (Miller-Rabin or Lucas) ruled out
+        ModExp,         // Modular exponentiations, a Lucas chain counting as one
+        ModMul,         // Modular products, squarings not included
+        ModSqr,         // Modular squarings
+        COUNTERS
+    };
+
+    enum Phase { Parse, Sieve, Prefilter, MillerRabin, Count, Output, PHASES };
+
+    // Turns the counters on, with the wall clock running from `since`; call it before
+    // starting the threads that should be counted
+    static void enable(Clock::time_point since = Clock::now()) {
+        on = true;
+        started = since;
+    }
+
+    static bool enabled() { return on; }
+
+    static void add(Counter c, uint64_t n = 1) {
+        if (on) bump(local().counts[c], n);
+    }
+
+    static void addTime(Phase phase, Clock::time_point since) {
+        if (on) bump(local().phases[phase], nanos(since));
+    }
+
+    // Adds its lifetime to a phase
+    class Timer {
+    public:
+        explicit Timer(Phase phase) : phase(phase) {
+            if (on) start = Clock::now();
+        }
+        ~Timer() { addTime(phase, start); }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Phase phase;
+        Clock::time_point start;
+    };
+
+    // Adds its lifetime to the calling pool worker's busy time, for its utilization
+    class Busy {
+    public:
+        Busy() {
+            if (on) start = Clock::now();
+        }
+        ~Busy() {
+            if (!on) return;
+            Block& block = local();
+            block.worker = true;
+            bump(block.busy, nanos(start));
+        }
+        Busy(const Busy&) = delete;
+        Busy& operator=(const Busy&) = delete;
+
+    private:
+        Clock::time_point start;
+    };
+
+    // Everything counted since enable(), readable (default) or as one JSON object. Call it
+    // once the counted work has finished. Phases that ran on several threads at once add
+    // up, so together they can exceed the wall time.
+    static void report(std::ostream& os, bool json);
+
+private:
+    struct Block {
+        // Relaxed atomics only the owner writes: plain loads and stores, read safely by report()
+        std::atomic<uint64_t> counts[COUNTERS] = {};
+        std::atomic<uint64_t> phases[PHASES] = {};
+        std::atomic<uint64_t> busy{0};
+        std::atomic<bool> worker{false};
+    };
+
+    static inline bool on = false;
+    static inline Clock::time_point started;
+
+    static void bump(std::atomic<uint64_t>& x, uint64_t n) {
+        x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static uint64_t nanos(Clock::time_point since) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count();
+    }
+
+    // Blocks outlive their threads, so a report after a pool has shut down still sees them
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+    static std::vector<std::unique_ptr<Block>>& registry() {
+        static std::vector<std::unique_ptr<Block>> blocks;
+        return blocks;
+    }
+
+    static Block& local() {
+        thread_local Block* block = [] {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            registry().push_back(std::make_unique<Block>());
+            return registry().back().get();
+        }();
+        return *block;
+    }
+};
+
+inline void Stats::report(std::ostream& os, bool json) {
+    static const char* const counterNames[COUNTERS] = {
+        "sieved", "sieve_rejected", "tested", "trial_rejected", "base2_rejected", "rounds_rejected",
+        "modexp", "modmul", "modsqr"};
+    static const char* const phaseNames[PHASES] = {"parse", "sieve", "prefilter", "miller_rabin", "count", "output"};
+    uint64_t wall = nanos(started) / 1000;
+    uint64_t counts[COUNTERS] = {}, phases[PHASES] = {};
+    std::vector<uint64_t> busy;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (const auto& block : registry()) {
+            for (int c = 0; c < COUNTERS; ++c) counts[c] += block->counts[c].load(std::memory_order_relaxed);
+            for (int p = 0; p < PHASES; ++p) phases[p] += block->phases[p].load(std::memory_order_relaxed) / 1000;
+            if (block->worker) busy.push_back(block->busy.load(std::memory_order_relaxed) / 1000);
+        }
+    }
+    double rate = wall ? counts[Tested] * 1e6 / wall : 0;
+    auto percent = [&](uint64_t us) { return wall ? 100.0 * us / wall : 0.0; };
+    if (json) {
+        os << "{\"wall_us\":" << wall << ",\"phases_us\":{";
+        for (int p = 0; p < PHASES; ++p) os << (p ? "," : "") << '"' << phaseNames[p] << "\":" << phases[p];
+        os << "},\"counters\":{";
+        for (int c = 0; c < COUNTERS; ++c) os << (c ? "," : "") << '"' << counterNames[c] << "\":" << counts[c];
+        os << "},\"candidates_per_s\":" << (uint64_t)rate << ",\"workers\":[";
+        for (size_t i = 0; i < busy.size(); ++i)
+            os << (i ? "," : "") << "{\"busy_us\":" << busy[i] << ",\"utilization\":" << percent(busy[i]) / 100 << "}";
+        os << "]}\n";
+        return;
+    }
+    auto row = [&](const std::string& name, auto value) {
+        os << "  " << name << std::string(name.size() < 20 ? 20 - name.size() : 1, ' ') << value << "\n";
+    };
+    os << "Stats (times in microseconds):\n";
+    row("wall", wall);
+    for (int p = 0; p < PHASES; ++p) row(phaseNames[p], phases[p]);
+    for (int c = 0; c < COUNTERS; ++c) row(counterNames[c], counts[c]);
+    row("candidates/s", (uint64_t)rate);
+    for (size_t i = 0; i < busy.size(); ++i)
+        row("worker " + std::to_string(i) + " busy",
+            std::to_string(busy[i]) + " (" + std::to_string((int)(percent(busy[i]) + 0.5)) + "%)");
+}
+
+#endif // STATS_HPP
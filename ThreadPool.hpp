@@ -0,0 +1,132 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Stats.hpp"
+
+// -----------------------------------
+// ThreadPool: work-stealing pool with a private deque per worker.
+// Workers pop their own queue from the back and steal from the front of the
+// others when it runs dry. Tasks submitted from outside the pool are spread
+// round-robin; tasks submitted by a worker stay on that worker's queue.
+// -----------------------------------
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i)
+            queues.push_back(std::make_unique<Queue>());
+        for (unsigned i = 0; i < threads; ++i)
+            workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    template <typename F>
+    auto submit(F&& f) -> std::future<decltype(f())> {
+        using Result = decltype(f());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+        std::future<Result> future = task->get_future();
+        unsigned id = currentPool() == this ? currentWorker() : nextQueue++ % size();
+        {
+            std::lock_guard<std::mutex> lock(queues[id]->mutex);
+            queues[id]->tasks.emplace_back([task] { (*task)(); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            ++pending;
+        }
+        wake.notify_one();
+        return future;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    size_t pending = 0;
+    bool stopping = false;
+    std::atomic<unsigned> nextQueue{0};
+
+    static const ThreadPool*& currentPool() {
+        thread_local const ThreadPool* pool = nullptr;
+        return pool;
+    }
+    static unsigned& currentWorker() {
+        thread_local unsigned id = 0;
+        return id;
+    }
+
+    bool tryPop(unsigned id, std::function<void()>& task) {
+        {
+            Queue& own = *queues[id];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (unsigned k = 1; k < size(); ++k) {
+            Queue& victim = *queues[(id + k) % size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(unsigned id) {
+        currentPool() = this;
+        currentWorker() = id;
+        std::function<void()> task;
+        while (true) {
+            if (tryPop(id, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(wakeMutex);
+                    --pending;
+                }
+                {
+                    Stats::Busy busy;
+                    task();
+                }
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [this] { return stopping || pending > 0; });
+            if (stopping && pending == 0) return;
+        }
+    }
+};
+
+#endif // THREADPOOL_HPP
@@ -0,0 +1,402 @@
+#ifndef WORDKERNELS_HPP
+#define WORDKERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <immintrin.h>
+
+// -----------------------------------
+// WordKernels: loops over arrays of 64-bit words (bitwise ops, compares, and
+// funnel shifts) in scalar, AVX2 and AVX-512 flavours, plus a radix-2^52
+// Montgomery product on AVX-512 IFMA. Vector variants are compiled through
+// target attributes, so the file builds without -mavx*; the best one the CPU
+// supports is picked once at startup. Callers keep short arrays inline and
+// only come here at VECTOR_MIN_WORDS or more, where one indirect call pays off.
+// -----------------------------------
+
+// GCC's AVX-512 intrinsics seed their "undefined" operands from themselves, which
+// trips -Wmaybe-uninitialized wherever they inline
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+class WordKernels {
+public:
+    enum class Level { Scalar, AVX2, AVX512 };
+
+    static constexpr size_t VECTOR_MIN_WORDS = 8;
+
+    // The level in use: detected on first call, or as last set by select()
+    static Level level() { return table().level; }
+
+    // Forces a level (clamped to what the CPU supports), for tests and benchmarks
+    static void select(Level want) { configure(table(), want); }
+
+    // True when the IFMA Montgomery product can run on this CPU
+    static bool hasIfma() { return table().ifma; }
+
+    static void andWords(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) { table().andFn(r, a, b, n); }
+    static void orWords(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) { table().orFn(r, a, b, n); }
+    static void xorWords(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) { table().xorFn(r, a, b, n); }
+    static void notWords(uint64_t* r, const uint64_t* a, size_t n) { table().notFn(r, a, n); }
+
+    // Index of the highest word where a and b differ, or n when they are equal
+    static size_t highestDifference(const uint64_t* a, const uint64_t* b, size_t n) { return table().diffFn(a, b, n); }
+
+    // r[i] = a[i] << s | a[i - 1] >> (64 - s) for i in [0, n), with a[-1] read as 0 and 0 < s < 64.
+    // Works top down, so r may alias a or sit above it.
+    static void shiftLeft(uint64_t* r, const uint64_t* a, size_t n, unsigned s) { table().shlFn(r, a, n, s); }
+
+    // r[i] = a[i] >> s | a[i + 1] << (64 - s) for i in [0, n), with a[n] read as 0 and 0 < s < 64.
+    // Works bottom up, so r may alias a or sit below it.
+    static void shiftRight(uint64_t* r, const uint64_t* a, size_t n, unsigned s) { table().shrFn(r, a, n, s); }
+
+    // Radix-2^52 almost-Montgomery product: r = a * b * 2^(-52m) mod n, below 2n, for m-digit
+    // a, b < n and k0 = -n^-1 mod 2^52, with m < 128. Digits are one per uint64_t; every
+    // array holds digits(m) entries with zeros past m. Only valid when hasIfma().
+    static void montMul52(uint64_t* r, const uint64_t* a, const uint64_t* b, const uint64_t* n, uint64_t k0,
+                          size_t m) {
+        montMul52Ifma(r, a, b, n, k0, m);
+    }
+
+    // Entries a radix-2^52 operand of m digits occupies: whole vectors plus one spare
+    static constexpr size_t digits(size_t m) { return (m / 8 + 1) * 8; }
+
+    // Operands montMul52x8() takes side by side
+    static constexpr size_t LANES = 8;
+    static constexpr size_t LANE_DIGITS_MAX = 96;
+
+    // LANES independent radix-2^52 Montgomery products, one per 64-bit lane: entry 8t + j is
+    // digit t of operand j. r_j = a_j * b_j * 2^(-52m) mod n_j, doubled in the lanes whose bit
+    // is set in twice, in normalized digits. With 2^(52m) >= 16 n_j and a_j, b_j < 4 n_j the
+    // product is below 2 n_j, so the doubled one stays below 4 n_j and can be fed straight
+    // back. k0[j] = -n_j^-1 mod 2^52; m <= LANE_DIGITS_MAX. Only valid when hasIfma().
+    static void montMul52x8(uint64_t* r, const uint64_t* a, const uint64_t* b, const uint64_t* n,
+                            const uint64_t* k0, size_t m, uint8_t twice) {
+        montMul52x8Ifma(r, a, b, n, k0, m, twice);
+    }
+
+private:
+    using BinaryFn = void (*)(uint64_t*, const uint64_t*, const uint64_t*, size_t);
+    using UnaryFn = void (*)(uint64_t*, const uint64_t*, size_t);
+    using DiffFn = size_t (*)(const uint64_t*, const uint64_t*, size_t);
+    using ShiftFn = void (*)(uint64_t*, const uint64_t*, size_t, unsigned);
+
+    struct Table {
+        Level level;
+        bool ifma;
+        BinaryFn andFn, orFn, xorFn;
+        UnaryFn notFn;
+        DiffFn diffFn;
+        ShiftFn shlFn, shrFn;
+    };
+
+    static Table& table() {
+        static Table t = [] {
+            Table init{};
+            configure(init, Level::AVX512);
+            return init;
+        }();
+        return t;
+    }
+
+    static void configure(Table& t, Level want) {
+        __builtin_cpu_init();
+        bool avx2 = __builtin_cpu_supports("avx2");
+        bool avx512 = __builtin_cpu_supports("avx512f");
+        if (want == Level::AVX512 && !avx512) want = Level::AVX2;
+        if (want == Level::AVX2 && !avx2) want = Level::Scalar;
+        t.level = want;
+        t.ifma = want == Level::AVX512 && __builtin_cpu_supports("avx512ifma");
+        if (want == Level::AVX512) {
+            t.andFn = andAvx512;
+            t.orFn = orAvx512;
+            t.xorFn = xorAvx512;
+            t.notFn = notAvx512;
+            t.diffFn = diffAvx512;
+            t.shlFn = shlAvx512;
+            t.shrFn = shrAvx512;
+        } else if (want == Level::AVX2) {
+            t.andFn = andAvx2;
+            t.orFn = orAvx2;
+            t.xorFn = xorAvx2;
+            t.notFn = notAvx2;
+            t.diffFn = diffAvx2;
+            t.shlFn = shlAvx2;
+            t.shrFn = shrAvx2;
+        } else {
+            t.andFn = andScalar;
+            t.orFn = orScalar;
+            t.xorFn = xorScalar;
+            t.notFn = notScalar;
+            t.diffFn = diffScalar;
+            t.shlFn = shlScalar;
+            t.shrFn = shrScalar;
+        }
+    }
+
+    // Scalar
+
+    static void andScalar(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; ++i) r[i] = a[i] & b[i];
+    }
+    static void orScalar(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; ++i) r[i] = a[i] | b[i];
+    }
+    static void xorScalar(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; ++i) r[i] = a[i] ^ b[i];
+    }
+    static void notScalar(uint64_t* r, const uint64_t* a, size_t n) {
+        for (size_t i = 0; i < n; ++i) r[i] = ~a[i];
+    }
+    static size_t diffScalar(const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = n; i-- > 0;)
+            if (a[i] != b[i]) return i;
+        return n;
+    }
+    static void shlScalar(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        for (size_t i = n; i-- > 1;) r[i] = a[i] << s | a[i - 1] >> (64 - s);
+        if (n) r[0] = a[0] << s;
+    }
+    static void shrScalar(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        for (size_t i = 0; i + 1 < n; ++i) r[i] = a[i] >> s | a[i + 1] << (64 - s);
+        if (n) r[n - 1] = a[n - 1] >> s;
+    }
+
+    // AVX2: four words per step, the remainder in scalar
+
+    __attribute__((target("avx2"))) static void andAvx2(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            store4(r + i, _mm256_and_si256(load4(a + i), load4(b + i)));
+        andScalar(r + i, a + i, b + i, n - i);
+    }
+    __attribute__((target("avx2"))) static void orAvx2(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            store4(r + i, _mm256_or_si256(load4(a + i), load4(b + i)));
+        orScalar(r + i, a + i, b + i, n - i);
+    }
+    __attribute__((target("avx2"))) static void xorAvx2(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+            store4(r + i, _mm256_xor_si256(load4(a + i), load4(b + i)));
+        xorScalar(r + i, a + i, b + i, n - i);
+    }
+    __attribute__((target("avx2"))) static void notAvx2(uint64_t* r, const uint64_t* a, size_t n) {
+        size_t i = 0;
+        const __m256i ones = _mm256_set1_epi64x(-1);
+        for (; i + 4 <= n; i += 4)
+            store4(r + i, _mm256_xor_si256(load4(a + i), ones));
+        notScalar(r + i, a + i, n - i);
+    }
+    __attribute__((target("avx2"))) static size_t diffAvx2(const uint64_t* a, const uint64_t* b, size_t n) {
+        // Whole blocks of four from the top; a block with a difference is finished in scalar
+        size_t i = n;
+        for (; i >= 4; i -= 4) {
+            __m256i eq = _mm256_cmpeq_epi64(load4(a + i - 4), load4(b + i - 4));
+            if (_mm256_movemask_epi8(eq) != -1) return diffScalar(a + i - 4, b + i - 4, 4) + i - 4;
+        }
+        size_t d = diffScalar(a, b, i);
+        return d == i ? n : d;
+    }
+    __attribute__((target("avx2"))) static void shlAvx2(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        const __m128i left = _mm_cvtsi32_si128(s), right = _mm_cvtsi32_si128(64 - s);
+        size_t i = n;
+        // Both loads of a block happen before its store, and lower blocks read only below it
+        for (; i >= 5; i -= 4) {
+            __m256i hi = load4(a + i - 4), lo = load4(a + i - 5);
+            store4(r + i - 4, _mm256_or_si256(_mm256_sll_epi64(hi, left), _mm256_srl_epi64(lo, right)));
+        }
+        shlScalar(r, a, i, s);
+    }
+    __attribute__((target("avx2"))) static void shrAvx2(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        const __m128i right = _mm_cvtsi32_si128(s), left = _mm_cvtsi32_si128(64 - s);
+        size_t i = 0;
+        for (; i + 5 <= n; i += 4) {
+            __m256i lo = load4(a + i), hi = load4(a + i + 1);
+            store4(r + i, _mm256_or_si256(_mm256_srl_epi64(lo, right), _mm256_sll_epi64(hi, left)));
+        }
+        for (; i + 1 < n; ++i) r[i] = a[i] >> s | a[i + 1] << (64 - s);
+        if (i < n) r[i] = a[i] >> s;
+    }
+
+    __attribute__((target("avx2"))) static __m256i load4(const uint64_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    __attribute__((target("avx2"))) static void store4(uint64_t* p, __m256i v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+    }
+
+    // AVX-512: eight words per step, the remainder under a mask
+
+    __attribute__((target("avx512f"))) static void andAvx512(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; i += 8) {
+            __mmask8 m = tail(n - i);
+            _mm512_mask_storeu_epi64(r + i, m, _mm512_and_si512(_mm512_maskz_loadu_epi64(m, a + i),
+                                                                 _mm512_maskz_loadu_epi64(m, b + i)));
+        }
+    }
+    __attribute__((target("avx512f"))) static void orAvx512(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; i += 8) {
+            __mmask8 m = tail(n - i);
+            _mm512_mask_storeu_epi64(r + i, m, _mm512_or_si512(_mm512_maskz_loadu_epi64(m, a + i),
+                                                                _mm512_maskz_loadu_epi64(m, b + i)));
+        }
+    }
+    __attribute__((target("avx512f"))) static void xorAvx512(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = 0; i < n; i += 8) {
+            __mmask8 m = tail(n - i);
+            _mm512_mask_storeu_epi64(r + i, m, _mm512_xor_si512(_mm512_maskz_loadu_epi64(m, a + i),
+                                                                 _mm512_maskz_loadu_epi64(m, b + i)));
+        }
+    }
+    __attribute__((target("avx512f"))) static void notAvx512(uint64_t* r, const uint64_t* a, size_t n) {
+        const __m512i ones = _mm512_set1_epi64(-1);
+        for (size_t i = 0; i < n; i += 8) {
+            __mmask8 m = tail(n - i);
+            _mm512_mask_storeu_epi64(r + i, m, _mm512_xor_si512(_mm512_maskz_loadu_epi64(m, a + i), ones));
+        }
+    }
+    __attribute__((target("avx512f"))) static size_t diffAvx512(const uint64_t* a, const uint64_t* b, size_t n) {
+        for (size_t i = n; i > 0;) {
+            size_t len = i >= 8 ? 8 : i;
+            i -= len;
+            __mmask8 m = tail(len);
+            __mmask8 ne = _mm512_mask_cmpneq_epu64_mask(m, _mm512_maskz_loadu_epi64(m, a + i),
+                                                        _mm512_maskz_loadu_epi64(m, b + i));
+            if (ne) return i + 31 - __builtin_clz((unsigned)ne);
+        }
+        return n;
+    }
+    __attribute__((target("avx512f"))) static void shlAvx512(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        const __m128i left = _mm_cvtsi32_si128(s), right = _mm_cvtsi32_si128(64 - s);
+        size_t i = n;
+        for (; i >= 9; i -= 8) {
+            __m512i hi = _mm512_loadu_si512(a + i - 8), lo = _mm512_loadu_si512(a + i - 9);
+            _mm512_storeu_si512(r + i - 8, _mm512_or_si512(_mm512_sll_epi64(hi, left), _mm512_srl_epi64(lo, right)));
+        }
+        shlScalar(r, a, i, s);
+    }
+    __attribute__((target("avx512f"))) static void shrAvx512(uint64_t* r, const uint64_t* a, size_t n, unsigned s) {
+        const __m128i right = _mm_cvtsi32_si128(s), left = _mm_cvtsi32_si128(64 - s);
+        size_t i = 0;
+        for (; i + 9 <= n; i += 8) {
+            __m512i lo = _mm512_loadu_si512(a + i), hi = _mm512_loadu_si512(a + i + 1);
+            _mm512_storeu_si512(r + i, _mm512_or_si512(_mm512_srl_epi64(lo, right), _mm512_sll_epi64(hi, left)));
+        }
+        for (; i + 1 < n; ++i) r[i] = a[i] >> s | a[i + 1] << (64 - s);
+        if (i < n) r[i] = a[i] >> s;
+    }
+
+    // Lanes [0, len) of a vector, for len >= 1
+    static __mmask8 tail(size_t len) { return len >= 8 ? 0xff : (__mmask8)((1u << len) - 1); }
+
+    // AVX-512 IFMA. Word-serial: each step adds a * b[i] + q * n across all digits at once,
+    // low products into their own digit and high products into the next, then drops the
+    // zeroed bottom digit by sliding every lane down one. Lanes gather at most 4m products
+    // of 52 bits before they are normalized, far below 2^64 for the m < 128 handled here.
+    // Instantiated per vector count so the accumulator stays in registers.
+    template <size_t V>
+    __attribute__((target("avx512f,avx512ifma"))) static void montMul52Fixed(uint64_t* r, const uint64_t* a,
+                                                                              const uint64_t* b, const uint64_t* n,
+                                                                              uint64_t k0, size_t m) {
+        constexpr uint64_t MASK = (uint64_t(1) << 52) - 1;
+        __m512i acc[V], va[V], vn[V];
+        for (size_t v = 0; v < V; ++v) {
+            acc[v] = _mm512_setzero_si512();
+            va[v] = _mm512_loadu_si512(a + 8 * v);
+            vn[v] = _mm512_loadu_si512(n + 8 * v);
+        }
+        // The bottom digit is shadowed in scalar so the next q need not wait on the vector
+        // chain: it is the old second digit plus everything this step adds below bit 104
+        uint64_t acc0 = 0;
+        for (size_t i = 0; i < m; ++i) {
+            uint64_t second = (uint64_t)_mm_extract_epi64(_mm512_castsi512_si128(acc[0]), 1);
+            __m512i bi = _mm512_set1_epi64(b[i]);
+            // q clears the bottom digit: (acc_0 + lo(a_0 b_i)) * k0 mod 2^52
+            uint64_t t0 = acc0 + ((a[0] * b[i]) & MASK);
+            uint64_t q = (t0 * k0) & MASK;
+            uint64_t carry = (t0 + ((n[0] * q) & MASK)) >> 52;
+            __m512i qi = _mm512_set1_epi64(q);
+            for (size_t v = 0; v < V; ++v) {
+                acc[v] = _mm512_madd52lo_epu64(acc[v], va[v], bi);
+                acc[v] = _mm512_madd52lo_epu64(acc[v], vn[v], qi);
+            }
+            // Slide down one digit, carrying what sat above bit 52 of the bottom one
+            for (size_t v = 0; v + 1 < V; ++v) acc[v] = _mm512_alignr_epi64(acc[v + 1], acc[v], 1);
+            acc[V - 1] = _mm512_alignr_epi64(_mm512_setzero_si512(), acc[V - 1], 1);
+            acc[0] = _mm512_add_epi64(acc[0], _mm512_maskz_set1_epi64(1, (long long)carry));
+            // High halves belong one digit up, which after the slide is their own index
+            for (size_t v = 0; v < V; ++v) {
+                acc[v] = _mm512_madd52hi_epu64(acc[v], va[v], bi);
+                acc[v] = _mm512_madd52hi_epu64(acc[v], vn[v], qi);
+            }
+            acc0 = second + ((a[1] * b[i]) & MASK) + ((n[1] * q) & MASK) + carry +
+                   (uint64_t)(((__uint128_t)a[0] * b[i]) >> 52) + (uint64_t)(((__uint128_t)n[0] * q) >> 52);
+        }
+        uint64_t out[8 * V];
+        for (size_t v = 0; v < V; ++v) _mm512_storeu_si512(out + 8 * v, acc[v]);
+        // Normalize to 52-bit digits
+        uint64_t carry = 0;
+        for (size_t j = 0; j < 8 * V; ++j) {
+            uint64_t t = out[j] + carry;
+            r[j] = t & MASK;
+            carry = t >> 52;
+        }
+    }
+
+    using Mul52Fn = void (*)(uint64_t*, const uint64_t*, const uint64_t*, const uint64_t*, uint64_t, size_t);
+
+    template <size_t... V>
+    static Mul52Fn mul52Kernel(size_t vectors, std::index_sequence<V...>) {
+        static constexpr Mul52Fn kernels[] = {montMul52Fixed<V + 1>...};
+        return kernels[vectors - 1];
+    }
+
+    static void montMul52Ifma(uint64_t* r, const uint64_t* a, const uint64_t* b, const uint64_t* n, uint64_t k0,
+                              size_t m) {
+        mul52Kernel(digits(m) / 8, std::make_index_sequence<16>())(r, a, b, n, k0, m);
+    }
+
+    // Vertical layout: every instruction works on the same digit of all eight products, so q
+    // comes from one more madd52lo and nothing crosses lanes. Row i adds a * b_i + q * n at
+    // digits i.., whose bottom digit q clears; t then holds the result from digit m.
+    __attribute__((target("avx512f,avx512ifma"))) static void montMul52x8Ifma(uint64_t* r, const uint64_t* a,
+                                                                               const uint64_t* b, const uint64_t* n,
+                                                                               const uint64_t* k0, size_t m,
+                                                                               uint8_t twice) {
+        const __m512i mask = _mm512_set1_epi64((uint64_t(1) << 52) - 1);
+        const __m512i zero = _mm512_setzero_si512(), vk0 = _mm512_loadu_si512(k0);
+        __m512i t[2 * LANE_DIGITS_MAX + 1];
+        for (size_t i = 0; i <= 2 * m; ++i) t[i] = zero;
+        for (size_t i = 0; i < m; ++i) {
+            __m512i bi = _mm512_loadu_si512(b + 8 * i);
+            t[i] = _mm512_madd52lo_epu64(t[i], _mm512_loadu_si512(a), bi);
+            __m512i q = _mm512_madd52lo_epu64(zero, t[i], vk0);
+            t[i] = _mm512_madd52lo_epu64(t[i], _mm512_loadu_si512(n), q);
+            for (size_t j = 1; j < m; ++j) {
+                __m512i aj = _mm512_loadu_si512(a + 8 * j), nj = _mm512_loadu_si512(n + 8 * j);
+                t[i + j] = _mm512_madd52lo_epu64(_mm512_madd52lo_epu64(t[i + j], aj, bi), nj, q);
+            }
+            for (size_t j = 0; j < m; ++j) {
+                __m512i aj = _mm512_loadu_si512(a + 8 * j), nj = _mm512_loadu_si512(n + 8 * j);
+                t[i + j + 1] = _mm512_madd52hi_epu64(_mm512_madd52hi_epu64(t[i + j + 1], aj, bi), nj, q);
+            }
+            t[i + 1] = _mm512_add_epi64(t[i + 1], _mm512_srli_epi64(t[i], 52));
+        }
+        // Double where asked, then normalize; the result fits in m digits
+        __m512i carry = zero;
+        for (size_t i = 0; i < m; ++i) {
+            __m512i v = _mm512_mask_add_epi64(t[m + i], twice, t[m + i], t[m + i]);
+            v = _mm512_add_epi64(v, carry);
+            _mm512_storeu_si512(r + 8 * i, _mm512_and_si512(v, mask));
+            carry = _mm512_srli_epi64(v, 52);
+        }
+    }
+};
+
+#pragma GCC diagnostic pop
+
+#endif // WORDKERNELS_HPP
@@ -0,0 +1,136 @@
+// -----------------------------------
+// oprime_bench: BigInt4096 kernels at 64 to 4096 bits, and end-to-end runs of the
+// oprime binary. A size is the width of the product for operator*, of the dividend
+// (over a divisor half as wide) for operator%, and of the modulus for modExp and
+// isPrime, which tests the largest prime below 2^size.
+//
+//   oprime_bench --benchmark_out=new.json --benchmark_out_format=json
+//   compare.py benchmarks bench/baseline.json new.json   (Google Benchmark's tools/)
+//
+// bench/baseline.json is such a run; refresh it when a change moves the numbers
+// on purpose, with the machine it came from in its context block.
+// -----------------------------------
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "BigInt4096.hpp"
+
+namespace {
+
+// Uniform value of exactly `bits` bits; odd when asked
+BigInt4096 operand(size_t bits, uint64_t seed, bool odd = false) {
+    std::mt19937_64 rng(seed);
+    BigInt4096 x;
+    for (size_t done = 0; done < bits; done += 64) {
+        size_t take = std::min<size_t>(64, bits - done);
+        uint64_t word = take < 64 ? rng() >> (64 - take) : rng();
+        if (done + take == bits) word |= uint64_t(1) << (take - 1);
+        x = (x << take) + BigInt4096(word);
+    }
+    if (odd) x = x | BigInt4096(1);
+    return x;
+}
+
+// Largest prime below 2^bits; the offsets come from oprime --le
+BigInt4096 primeBelow(size_t bits) {
+    uint64_t offset = 0;
+    switch (bits) {
+        case 64: offset = 59; break;
+        case 256: offset = 189; break;
+        case 1024: offset = 105; break;
+        case 2048: offset = 1557; break;
+        case 4096: offset = 2549; break;
+    }
+    // 1 << 4096 is zero, and the subtraction wraps to 2^4096 - offset
+    return (BigInt4096(1) << bits) - BigInt4096(offset);
+}
+
+std::string decimal(const BigInt4096& x) {
+    std::ostringstream os;
+    os << x;
+    return os.str();
+}
+
+void sizes(benchmark::internal::Benchmark* b) {
+    for (int bits : {64, 256, 1024, 2048, 4096}) b->Arg(bits);
+}
+
+void BM_Mul(benchmark::State& state) {
+    size_t bits = (size_t)state.range(0);
+    BigInt4096 a = operand(bits / 2, 1), b = operand(bits / 2, 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(a * b);
+    }
+}
+BENCHMARK(BM_Mul)->Apply(sizes);
+
+void BM_Mod(benchmark::State& state) {
+    size_t bits = (size_t)state.range(0);
+    BigInt4096 a = operand(bits, 3), m = operand(bits / 2, 4);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(a % m);
+    }
+}
+BENCHMARK(BM_Mod)->Apply(sizes);
+
+void BM_ModExp(benchmark::State& state) {
+    size_t bits = (size_t)state.range(0);
+    BigInt4096 m = operand(bits, 5, true);
+    BigInt4096 base = operand(bits - 1, 6), exp = operand(bits, 7);
+    for (auto _ : state) benchmark::DoNotOptimize(BigInt4096::modExp(base, exp, m));
+}
+BENCHMARK(BM_ModExp)->Apply(sizes)->Unit(benchmark::kMicrosecond);
+
+void BM_IsPrime(benchmark::State& state) {
+    BigInt4096 p = primeBelow((size_t)state.range(0));
+    for (auto _ : state) {
+        bool prime = BigInt4096::isPrime(p);
+        if (!prime) {
+            state.SkipWithError("primeBelow() is not prime");
+            break;
+        }
+        benchmark::DoNotOptimize(prime);
+    }
+}
+BENCHMARK(BM_IsPrime)->Apply(sizes)->Unit(benchmark::kMillisecond);
+
+// One run of the oprime binary with its output discarded, from a scratch directory
+// so that --all leaves its primes.txt there
+void runOprime(benchmark::State& state, const std::string& args) {
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "oprime_bench";
+    std::filesystem::create_directories(dir);
+    std::string command = "cd '" + dir.string() + "' && '" OPRIME_EXE "' " + args + " > /dev/null";
+    for (auto _ : state) {
+        if (std::system(command.c_str()) != 0) {
+            state.SkipWithError(("failed: " + command).c_str());
+            break;
+        }
+    }
+}
+
+void BM_Nth(benchmark::State& state) {
+    runOprime(state, "-n " + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_Nth)->Arg(1000000)->Arg(100000000)->Arg(10000000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_Le(benchmark::State& state) {
+    runOprime(state, "--le " + decimal(BigInt4096(1) << (size_t)state.range(0)));
+}
+BENCHMARK(BM_Le)->Arg(64)->Arg(1024)->Arg(2048)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_All(benchmark::State& state) {
+    runOprime(state, "--all " + std::to_string(state.range(0)));
+}
+BENCHMARK(BM_All)->Arg(10000000)->Arg(100000000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -1,39 +1,84 @@
 #include <iostream>
 #include <getopt.h>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <chrono>
+#include <cmath>
 #include <vector>
 #include <fstream>
-#include "BigInt4096.hpp"
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include "OPrime.hpp"
+#include "PrimeWriter.hpp"
 
 // -----------------------------------
-// WorkTask: Computes various prime-related tasks
+// WorkTask: runs a query on an oprime::Engine and reports it, on stdout or in
+// primes.txt for --all
 // -----------------------------------
 class WorkTask {
 public:
-    enum class Mode { NthPrime, LessThan, AllUpTo };
+    enum class Mode { NthPrime, LessThan, AtLeast, AllUpTo, Count };
 
-    WorkTask(Mode mode, const BigInt4096& value, unsigned int timeout_secs, bool show_runtime)
-        : mode(mode), value(value), timeout(timeout_secs), show_runtime(show_runtime) {
-        buckets = {BigInt4096(1), BigInt4096(2), BigInt4096(3), BigInt4096(5), BigInt4096(7), BigInt4096(9), BigInt4096(11)};
-    }
+    WorkTask(Mode mode, const BigInt4096& value, bool show_runtime,
+             PrimeWriter::Format format = PrimeWriter::Format::Text, const oprime::Options& options = oprime::Options())
+        : mode(mode), value(value), show_runtime(show_runtime), format(format), engine(options) {}
 
     void exec() {
         auto start = std::chrono::steady_clock::now();
         std::cout << "Starting prime task...\n";
-        BigInt4096 result(0);
-        if (mode == Mode::NthPrime) {
-            result = compute_nth_prime(value);
-            std::cout << "The " << value << "th prime is: " << result << "\n";
-        } else if (mode == Mode::LessThan) {
-            result = compute_prime_less_than(value);
-            std::cout << "Largest prime ≤ " << value << " is: " << result << "\n";
-        } else if (mode == Mode::AllUpTo) {
-            compute_all_primes_up_to(value);
-            std::cout << "Found " << primes.size() << " primes ≤ " << value << "\n";
-            write_primes_to_file("primes.txt");
+        bool native = value.bitLength() <= 64;
+        try {
+            // Each answer is in hand before its line starts, so a timeout report stands alone
+            if (mode == Mode::NthPrime) {
+                BigInt4096 p = answer(mode, value);
+                std::cout << "The " << value << "th prime is: " << p << "\n";
+            } else if (mode == Mode::LessThan) {
+                BigInt4096 p = answer(mode, value);
+                std::cout << "Largest prime ≤ " << value << " is: " << p << "\n";
+            } else if (mode == Mode::AtLeast) {
+                BigInt4096 p = answer(mode, value);
+                std::cout << "Smallest prime ≥ " << value << " is: " << p << "\n";
+            } else if (mode == Mode::Count) {
+                if (native) {
+                    BigInt4096 count = answer(mode, value);
+                    std::cout << "There are " << count << " primes ≤ " << value << "\n";
+                } else {
+                    std::cerr << "--count supports N below 2^64 only.\n";
+                }
+            } else if (mode == Mode::AllUpTo) {
+                // Primes stream to the file as each chunk completes instead of being collected first
+                bool gaps = format == PrimeWriter::Format::Gaps;
+                std::string filename = gaps ? "primes.gaps" : "primes.txt";
+                if (gaps && !native) {
+                    std::cerr << "The gaps format holds primes below 2^64 only.\n";
+                } else if (PrimeWriter out(filename, format); !out.ok()) {
+                    std::cerr << "Failed to open " << filename << " for writing.\n";
+                } else {
+                    // What was written before a timeout stays in the file
+                    try {
+                        engine.primes_in_range(BigInt4096(0), value, [&](const auto& p) { out.put(p); });
+                        std::cout << "Found " << out.count() << " primes ≤ " << value << "\n";
+                    } catch (const oprime::Timeout& t) {
+                        report(t);
+                    }
+                    bool closed;
+                    {
+                        Stats::Timer timer(Stats::Output);
+                        closed = out.close();
+                    }
+                    if (closed)
+                        std::cout << "Primes written to " << filename << "\n";
+                    else
+                        std::cerr << "Failed writing " << filename << "\n";
+                }
+            }
+        } catch (const oprime::Timeout& t) {
+            report(t);
         }
         auto end = std::chrono::steady_clock::now();
         auto total_elapsed = std::chrono::duration_cast<std::chrono::seconds>(end - start).count();
@@ -42,81 +87,42 @@ public:
         }
     }
 
-private:
-    Mode mode;
-    BigInt4096 value;
-    unsigned int timeout;
-    bool show_runtime;
-    std::vector<BigInt4096> primes;
-    std::vector<BigInt4096> buckets;
-
-    bool is_prime(const BigInt4096& num) {
-        return BigInt4096::isPrime(num);
-    }
-
-    BigInt4096 compute_nth_prime(const BigInt4096& n) {
-        BigInt4096 count(0);
-        BigInt4096 candidate(2);
-        auto start = std::chrono::steady_clock::now();
-        while (true) {
-            if (is_prime(candidate)) {
-                count += BigInt4096(1);
-                if (count == n)
-                    return candidate;
-            }
-            if (timeout > 0) {
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::seconds>(now - start).count() >= timeout) {
-                    std::cerr << "Timeout reached during nth-prime computation\n";
-                    return BigInt4096(0);
-                }
-            }
-            candidate += BigInt4096(1);
-        }
-    }
-
-    BigInt4096 compute_prime_less_than(const BigInt4096& n) {
-        if (n < BigInt4096(2)) return BigInt4096(0);
-        auto start = std::chrono::steady_clock::now();
-        for (BigInt4096 i = n; i >= BigInt4096(2); i -= BigInt4096(1)) {
-            if (is_prime(i)) return i;
-            if (timeout > 0) {
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::seconds>(now - start).count() >= timeout) {
-                    std::cerr << "Timeout reached during prime-less-than-n computation\n";
-                    return BigInt4096(0);
-                }
+    // Result of a single-value query (every mode but AllUpTo); 0 when there is no such prime.
+    // Each query gets the whole time limit, and throws oprime::Timeout when that runs out.
+    // Throws std::invalid_argument for queries the mode cannot answer.
+    BigInt4096 answer(Mode query, const BigInt4096& n) {
+        if (query == Mode::NthPrime) {
+            // Checkpoints gathered before a timeout are saved too, so the check runs either way
+            auto check_cache = [this] {
+                if (!engine.cache_saved()) std::cerr << "Failed to update the prime cache\n";
+            };
+            try {
+                BigInt4096 p = engine.nth_prime(n);
+                check_cache();
+                return p;
+            } catch (const oprime::Timeout&) {
+                check_cache();
+                throw;
             }
+        } else if (query == Mode::LessThan) {
+            return engine.prev_prime(n);
+        } else if (query == Mode::AtLeast) {
+            return engine.next_prime(n);
+        } else if (query == Mode::Count) {
+            return BigInt4096(engine.count_primes(n));
         }
-        return BigInt4096(0);
+        throw std::invalid_argument("all is not a single-value query");
     }
 
-    void compute_all_primes_up_to(const BigInt4096& n) {
-        auto start = std::chrono::steady_clock::now();
-        for (BigInt4096 i = BigInt4096(2); i <= n; i += BigInt4096(1)) {
-            if (is_prime(i)) {
-                primes.push_back(i);
-            }
-            if (timeout > 0) {
-                auto now = std::chrono::steady_clock::now();
-                if (std::chrono::duration_cast<std::chrono::seconds>(now - start).count() >= timeout) {
-                    std::cerr << "Timeout reached during all-primes-up-to computation\n";
-                    break;
-                }
-            }
-        }
-    }
+private:
+    Mode mode;
+    BigInt4096 value;
+    bool show_runtime;
+    PrimeWriter::Format format;
+    oprime::Engine engine;
 
-    void write_primes_to_file(const std::string& filename) {
-        std::ofstream file(filename);
-        if (!file) {
-            std::cerr << "Failed to open " << filename << " for writing.\n";
-            return;
-        }
-        for (const auto& prime : primes) {
-            file << prime << "\n";
-        }
-        std::cout << "Primes written to " << filename << "\n";
+    void report(const oprime::Timeout& t) const {
+        std::cerr << "Timeout reached after " << engine.elapsed_ms() << " ms: " << t.what() << "\n";
     }
 };
 
@@ -126,47 +132,162 @@ private:
 class TimedTaskApp {
 public:
     int run(int argc, char* argv[]) {
+        auto start = Stats::Clock::now();
         if (!parse_arguments(argc, argv)) {
             usage(argv[0]);
             return 1; // Explicit return for clarity, though usage() calls std::exit()
         }
-        WorkTask::Mode mode = has_n ? WorkTask::Mode::NthPrime :
-                              has_le ? WorkTask::Mode::LessThan :
-                                       WorkTask::Mode::AllUpTo;
-        BigInt4096 value = has_n ? n_value :
-                             has_le ? le_value :
-                                       all_value;
-        WorkTask task(mode, value, timeout, show_runtime);
-        task.exec();
-        return 0;
+        if (show_stats) {
+            Stats::enable(start);
+            Stats::addTime(Stats::Parse, start);
+        }
+        int status = has_batch ? run_batch() : run_task();
+        // The tasks and their pools are gone by now, so every worker's time is in
+        if (show_stats) Stats::report(std::cerr, stats_json);
+        return status;
     }
 
 private:
     bool has_n = false;
     bool has_le = false;
+    bool has_ge = false;
     bool has_all = false;
+    bool has_count = false;
+    bool has_batch = false;
+    std::string batch_source;
     bool show_runtime = false;
     BigInt4096 n_value = 0;
     BigInt4096 le_value = 0;
+    BigInt4096 ge_value = 0;
     BigInt4096 all_value = 0;
-    unsigned int timeout = 0;
+    BigInt4096 count_value = 0;
+    PrimeWriter::Format format = PrimeWriter::Format::Text;
+    // Threads, time limit, cache and primality settings for the engines
+    oprime::Options options;
+    bool show_stats = false;
+    bool stats_json = false;
+
+    int run_task() {
+        WorkTask::Mode mode = has_n ? WorkTask::Mode::NthPrime :
+                              has_le ? WorkTask::Mode::LessThan :
+                              has_ge ? WorkTask::Mode::AtLeast :
+                              has_count ? WorkTask::Mode::Count :
+                                       WorkTask::Mode::AllUpTo;
+        BigInt4096 value = has_n ? n_value :
+                             has_le ? le_value :
+                             has_ge ? ge_value :
+                             has_count ? count_value :
+                                       all_value;
+        WorkTask task(mode, value, show_runtime, format, options);
+        task.exec();
+        return 0;
+    }
+
+    // Answers one query per input line ("n N", "le N", "ge N" or "count N") with one output line,
+    // in input order. Queries run in parallel, one per thread, and each thread keeps its
+    // WorkTask, so the tables those build are reused from query to query.
+    int run_batch() {
+        std::ifstream file;
+        std::istream* in = &std::cin;
+        if (batch_source != "-") {
+            file.open(batch_source);
+            if (!file) {
+                std::cerr << "Failed to open " << batch_source << " for reading.\n";
+                return 1;
+            }
+            in = &file;
+        }
+        unsigned threads = options.threads;
+        oprime::Options single = options;
+        single.threads = 1;
+        std::mutex idle_mutex;
+        std::vector<std::unique_ptr<WorkTask>> idle;
+        for (unsigned i = 0; i < threads; ++i)
+            idle.push_back(std::make_unique<WorkTask>(WorkTask::Mode::NthPrime, 0, false, format, single));
+        ThreadPool workers(threads);
+        std::deque<std::future<std::string>> inflight;
+        auto print_ready = [&](size_t keep) {
+            while (!inflight.empty() && (inflight.size() > keep
+                   || inflight.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+                std::string result = inflight.front().get();
+                Stats::Timer timer(Stats::Output);
+                std::cout << result << '\n' << std::flush;
+                inflight.pop_front();
+            }
+        };
+        std::string line;
+        while (std::getline(*in, line)) {
+            inflight.push_back(workers.submit([&, line] {
+                std::unique_ptr<WorkTask> task;
+                {
+                    // At most `threads` queries run at once, so a task is always free
+                    std::lock_guard<std::mutex> lock(idle_mutex);
+                    task = std::move(idle.back());
+                    idle.pop_back();
+                }
+                std::string result = run_query(*task, line);
+                std::lock_guard<std::mutex> lock(idle_mutex);
+                idle.push_back(std::move(task));
+                return result;
+            }));
+            print_ready(2 * threads);
+        }
+        print_ready(0);
+        return 0;
+    }
+
+    static std::string run_query(WorkTask& task, const std::string& line) {
+        std::istringstream ss(line);
+        std::string name, arg, extra;
+        if (!(ss >> name)) return "";
+        WorkTask::Mode mode;
+        if (name == "n") mode = WorkTask::Mode::NthPrime;
+        else if (name == "le") mode = WorkTask::Mode::LessThan;
+        else if (name == "ge") mode = WorkTask::Mode::AtLeast;
+        else if (name == "count") mode = WorkTask::Mode::Count;
+        else return "error: unknown query " + name;
+        BigInt4096 value;
+        if (!(ss >> arg) || ss >> extra || !parse_BigInt4096(arg.c_str(), value))
+            return "error: " + name + " requires a valid integer";
+        try {
+            std::ostringstream out;
+            out << task.answer(mode, value);
+            return out.str();
+        } catch (const oprime::Timeout& e) {
+            return std::string("timeout: ") + e.what();
+        } catch (const std::exception& e) {
+            return std::string("error: ") + e.what();
+        }
+    }
 
     void usage(const char* progname) {
         std::cerr << "Usage:\n";
         std::cerr << "  " << progname << " -n <N>       # Nth prime\n";
         std::cerr << "  " << progname << " --le <N>    # Prime ≤ N\n";
+        std::cerr << "  " << progname << " --ge <N>    # Prime ≥ N\n";
         std::cerr << "  " << progname << " --all <N>   # All primes ≤ N (to primes.txt)\n";
+        std::cerr << "  " << progname << " --count <N> # Number of primes ≤ N\n";
+        std::cerr << "  " << progname << " --batch <FILE|-> # One \"n|le|ge|count N\" query per line\n";
         std::cerr << "Optional:\n";
-        std::cerr << "  -t <seconds>       # Limit execution time\n";
+        std::cerr << "  -t <seconds>       # Limit execution time, to the millisecond (e.g. 2.5)\n";
         std::cerr << "  --rt               # Print runtime\n";
-        std::cerr << "Exactly one of -n, --le, or --all must be specified.\n";
+        std::cerr << "  --threads <N>      # Worker threads for -n, --le, --ge, --all and --batch (default 1)\n";
+        std::cerr << "  --format=<F>       # --all output: text (primes.txt, default) or gaps (primes.gaps)\n";
+        std::cerr << "  --cache <DIR>      # Reuse and extend prime-count checkpoints for -n\n";
+        std::cerr << "  --primality=<T>    # Test for values past 64 bits: auto (default), bpsw, fixed or random\n";
+        std::cerr << "  --rounds <N>       # Miller-Rabin rounds for --primality=fixed and random (default 5)\n";
+        std::cerr << "  --device=<D>       # Where bulk tests of values past 64 bits run: cpu (default) or gpu\n";
+        std::cerr << "  --stats[=json]     # Timings (microseconds) and counters on stderr, as text or JSON\n";
+        std::cerr << "Exactly one of -n, --le, --ge, --all, --count, or --batch must be specified.\n";
         std::exit(EXIT_FAILURE);
     }
 
-    bool parse_BigInt4096(const char* arg, BigInt4096& out) {
-        std::istringstream ss(arg);
-        ss >> out;
-        return !ss.fail() && ss.eof();
+    // A whole token of decimal digits that fits in 4096 bits; signs, exponents, hex and
+    // trailing junk are rejected rather than skipped
+    static bool parse_BigInt4096(const char* arg, BigInt4096& out) {
+        const char* end = arg + std::strlen(arg);
+        auto parsed = BigInt4096::fromChars(arg, end, out);
+        return parsed.ec == std::errc() && parsed.ptr == end;
     }
 
     bool parse_arguments(int argc, char* argv[]) {
@@ -174,6 +295,16 @@ private:
             {"le", required_argument, nullptr, 1000},
             {"rt", no_argument, nullptr, 1001},
             {"all", required_argument, nullptr, 1002},
+            {"threads", required_argument, nullptr, 1003},
+            {"ge", required_argument, nullptr, 1004},
+            {"format", required_argument, nullptr, 1005},
+            {"cache", required_argument, nullptr, 1006},
+            {"count", required_argument, nullptr, 1007},
+            {"batch", required_argument, nullptr, 1008},
+            {"primality", required_argument, nullptr, 1009},
+            {"rounds", required_argument, nullptr, 1010},
+            {"device", required_argument, nullptr, 1011},
+            {"stats", optional_argument, nullptr, 1012},
             {0, 0, 0, 0}
         };
         optind = 1;
@@ -187,15 +318,20 @@ private:
                     }
                     has_n = true;
                     break;
+                case 't': {
+                    // Seconds, to the millisecond; 0 means no timeout, so allow it
+                    double seconds = -1;
                     try {
-                        timeout = std::stoul(optarg);
-                        // 0 means no timeout, so allow it
+                        seconds = std::stod(optarg);
                     } catch (...) {
-                        std::cerr << "Error: -t requires a non-negative integer.\n";
+                    }
+                    if (!(seconds >= 0 && seconds <= 1e9)) {
+                        std::cerr << "Error: -t requires a non-negative number of seconds.\n";
                         return false;
                     }
-                    
+                    options.timeout = std::chrono::milliseconds(std::llround(seconds * 1000));
                     break;
+                }
                 case 1000: // --le
                     if (!parse_BigInt4096(optarg, le_value)) {
                         std::cerr << "Error: --le requires a valid integer.\n";
@@ -213,11 +349,104 @@ private:
                     }
                     has_all = true;
                     break;
+                case 1003: // --threads
+                    try {
+                        options.threads = std::stoul(optarg);
+                    } catch (...) {
+                        options.threads = 0;
+                    }
+                    if (options.threads == 0) {
+                        std::cerr << "Error: --threads requires a positive integer.\n";
+                        return false;
+                    }
+                    break;
+                case 1004: // --ge
+                    if (!parse_BigInt4096(optarg, ge_value)) {
+                        std::cerr << "Error: --ge requires a valid integer.\n";
+                        return false;
+                    }
+                    has_ge = true;
+                    break;
+                case 1005: // --format
+                    if (std::string(optarg) == "text") {
+                        format = PrimeWriter::Format::Text;
+                    } else if (std::string(optarg) == "gaps") {
+                        format = PrimeWriter::Format::Gaps;
+                    } else {
+                        std::cerr << "Error: --format must be text or gaps.\n";
+                        return false;
+                    }
+                    break;
+                case 1006: // --cache
+                    options.cache_dir = optarg;
+                    break;
+                case 1007: // --count
+                    if (!parse_BigInt4096(optarg, count_value)) {
+                        std::cerr << "Error: --count requires a valid integer.\n";
+                        return false;
+                    }
+                    has_count = true;
+                    break;
+                case 1008: // --batch
+                    batch_source = optarg;
+                    has_batch = true;
+                    break;
+                case 1009: // --primality
+                    if (std::string(optarg) == "auto") {
+                        options.primality = oprime::PrimalityTest::Auto;
+                    } else if (std::string(optarg) == "bpsw") {
+                        options.primality = oprime::PrimalityTest::BailliePSW;
+                    } else if (std::string(optarg) == "fixed") {
+                        options.primality = oprime::PrimalityTest::FixedBases;
+                    } else if (std::string(optarg) == "random") {
+                        options.primality = oprime::PrimalityTest::RandomBases;
+                    } else {
+                        std::cerr << "Error: --primality must be auto, bpsw, fixed or random.\n";
+                        return false;
+                    }
+                    break;
+                case 1010: // --rounds
+                    try {
+                        options.rounds = std::stoi(optarg);
+                    } catch (...) {
+                        options.rounds = 0;
+                    }
+                    if (options.rounds <= 0 || (size_t)options.rounds > BigInt4096::TRIAL_PRIMES + 1) {
+                        std::cerr << "Error: --rounds requires an integer from 1 to "
+                                  << BigInt4096::TRIAL_PRIMES + 1 << ".\n";
+                        return false;
+                    }
+                    break;
+                case 1011: // --device
+                    if (std::string(optarg) == "cpu") {
+                        options.device = oprime::Device::CPU;
+                    } else if (std::string(optarg) == "gpu") {
+                        options.device = oprime::Device::GPU;
+                        if (!oprime::device_available(options.device)) {
+                            std::cerr << "Warning: this build has no GPU backend; running on the CPU.\n";
+                            options.device = oprime::Device::CPU;
+                        }
+                    } else {
+                        std::cerr << "Error: --device must be cpu or gpu.\n";
+                        return false;
+                    }
+                    break;
+                case 1012: // --stats
+                    if (!optarg || std::string(optarg) == "text") {
+                        stats_json = false;
+                    } else if (std::string(optarg) == "json") {
+                        stats_json = true;
+                    } else {
+                        std::cerr << "Error: --stats must be text or json.\n";
+                        return false;
+                    }
+                    show_stats = true;
+                    break;
                 default:
                     return false;
             }
         }
-        return (has_n + has_le + has_all == 1); // exactly one mode
+        return (has_n + has_le + has_ge + has_all + has_count + has_batch == 1); // exactly one mode
     }
 };
 
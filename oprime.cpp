@@ -0,0 +1,141 @@
+#include "oprime.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "OPrime.hpp"
+
+// -----------------------------------
+// C ABI over oprime::Engine: every exception stops here and becomes a status,
+// with its message kept for oprime_last_error()
+// -----------------------------------
+struct oprime_engine {
+    explicit oprime_engine(const oprime::Options& options) : engine(options) {}
+    oprime::Engine engine;
+    std::string error;
+};
+
+namespace {
+
+using Query = BigInt4096 (oprime::Engine::*)(const BigInt4096&);
+
+// The primes of a range below 2^64 come as uint64_t; the PrimeView form is only instantiated
+uint64_t value64(uint64_t p) { return p; }
+template <size_t Bits>
+uint64_t value64(const PrimeView<Bits>& p) { return (uint64_t)p.value(); }
+
+template <typename Fn>
+oprime_status guarded(oprime_engine* e, Fn&& fn) {
+    if (!e) return OPRIME_INVALID;
+    e->error.clear();
+    try {
+        return fn();
+    } catch (const oprime::Timeout& t) {
+        e->error = t.what();
+        return OPRIME_TIMEOUT;
+    } catch (const std::invalid_argument& x) {
+        e->error = x.what();
+        return OPRIME_INVALID;
+    } catch (const std::exception& x) {
+        e->error = x.what();
+        return OPRIME_ERROR;
+    } catch (...) {
+        e->error = "unknown error";
+        return OPRIME_ERROR;
+    }
+}
+
+oprime_status fail(oprime_engine* e, oprime_status status, const char* message) {
+    e->error = message;
+    return status;
+}
+
+oprime_status single(oprime_engine* e, Query query, uint64_t n, uint64_t* out) {
+    return guarded(e, [&] {
+        if (!out) return fail(e, OPRIME_INVALID, "no place for the answer");
+        BigInt4096 result = (e->engine.*query)(BigInt4096(n));
+        if (result.bitLength() > 64) return fail(e, OPRIME_OVERFLOW, "the answer does not fit in 64 bits");
+        *out = (uint64_t)result;
+        return OPRIME_OK;
+    });
+}
+
+oprime_status single(oprime_engine* e, Query query, const char* n, char* out, size_t size) {
+    return guarded(e, [&] {
+        if (!n || !out || !size) return fail(e, OPRIME_INVALID, "no argument or no place for the answer");
+        BigInt4096 value;
+        const char* end = n + std::strlen(n);
+        auto parsed = BigInt4096::fromChars(n, end, value);
+        if (parsed.ec != std::errc() || parsed.ptr != end) return fail(e, OPRIME_INVALID, "not a 4096-bit decimal");
+        BigInt4096 result = (e->engine.*query)(value);
+        auto written = result.toChars(out, out + size - 1);
+        if (written.ec != std::errc()) return fail(e, OPRIME_OVERFLOW, "the answer does not fit the buffer");
+        *written.ptr = '\0';
+        return OPRIME_OK;
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+oprime_engine* oprime_create(unsigned threads, uint64_t timeout_ms) {
+    oprime::Options options;
+    options.threads = threads ? threads : 1;
+    options.timeout = std::chrono::milliseconds(timeout_ms);
+    try {
+        return new oprime_engine(options);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void oprime_destroy(oprime_engine* engine) { delete engine; }
+
+const char* oprime_last_error(const oprime_engine* engine) { return engine ? engine->error.c_str() : ""; }
+
+oprime_status oprime_nth_prime(oprime_engine* engine, uint64_t n, uint64_t* prime) {
+    return single(engine, &oprime::Engine::nth_prime, n, prime);
+}
+
+oprime_status oprime_prev_prime(oprime_engine* engine, uint64_t n, uint64_t* prime) {
+    return single(engine, &oprime::Engine::prev_prime, n, prime);
+}
+
+oprime_status oprime_next_prime(oprime_engine* engine, uint64_t n, uint64_t* prime) {
+    return single(engine, &oprime::Engine::next_prime, n, prime);
+}
+
+oprime_status oprime_count_primes(oprime_engine* engine, uint64_t n, uint64_t* count) {
+    return guarded(engine, [&] {
+        if (!count) return fail(engine, OPRIME_INVALID, "no place for the answer");
+        *count = engine->engine.count_primes(BigInt4096(n));
+        return OPRIME_OK;
+    });
+}
+
+oprime_status oprime_nth_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size) {
+    return single(engine, &oprime::Engine::nth_prime, n, out, size);
+}
+
+oprime_status oprime_prev_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size) {
+    return single(engine, &oprime::Engine::prev_prime, n, out, size);
+}
+
+oprime_status oprime_next_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size) {
+    return single(engine, &oprime::Engine::next_prime, n, out, size);
+}
+
+oprime_status oprime_primes_in_range(oprime_engine* engine, uint64_t lo, uint64_t hi, oprime_prime_fn fn,
+                                     void* context, uint64_t* count) {
+    return guarded(engine, [&] {
+        if (!fn) return fail(engine, OPRIME_INVALID, "no callback");
+        // hi is below 2^64, so the primes arrive as uint64_t
+        uint64_t found = engine->engine.primes_in_range(BigInt4096(lo), BigInt4096(hi),
+                                                        [&](const auto& p) { fn(value64(p), context); });
+        if (count) *count = found;
+        return OPRIME_OK;
+    });
+}
+
+} // extern "C"
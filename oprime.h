@@ -0,0 +1,64 @@
+#ifndef OPRIME_H
+#define OPRIME_H
+
+/*
+ * oprime.h: C interface to the prime engines of OPrime.hpp, for embedding them
+ * without C++. An oprime_engine answers one query at a time; use one per
+ * thread for concurrent queries. Calls return an oprime_status and never
+ * throw; after a failure oprime_last_error() says what went wrong, and after a
+ * timeout how far the work got. Values below 2^64 go in and out as uint64_t;
+ * the _dec forms take and give decimal strings, up to 4096 bits.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct oprime_engine oprime_engine;
+
+typedef enum {
+    OPRIME_OK = 0,
+    OPRIME_TIMEOUT,  /* The time limit ran out */
+    OPRIME_INVALID,  /* An argument was malformed or out of range */
+    OPRIME_OVERFLOW, /* The answer does not fit the output: a uint64_t, or the buffer given */
+    OPRIME_ERROR     /* Anything else, out of memory for one */
+} oprime_status;
+
+/* NULL when the engine could not be created. threads 0 counts as 1; a timeout_ms of 0 is
+   no limit, and applies to each query separately. */
+oprime_engine* oprime_create(unsigned threads, uint64_t timeout_ms);
+void oprime_destroy(oprime_engine* engine);
+
+/* The message of the last failed call, "" when there was none; valid until the next call */
+const char* oprime_last_error(const oprime_engine* engine);
+
+/* The nth prime, counting 2 as the first; 0 for n = 0 */
+oprime_status oprime_nth_prime(oprime_engine* engine, uint64_t n, uint64_t* prime);
+/* The largest prime at most n; 0 below 2 */
+oprime_status oprime_prev_prime(oprime_engine* engine, uint64_t n, uint64_t* prime);
+/* The smallest prime at least n */
+oprime_status oprime_next_prime(oprime_engine* engine, uint64_t n, uint64_t* prime);
+/* The number of primes at most n */
+oprime_status oprime_count_primes(oprime_engine* engine, uint64_t n, uint64_t* count);
+
+/* Decimal forms: n as a string of digits, the answer written to out with its terminating
+   NUL, in at most size bytes */
+oprime_status oprime_nth_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size);
+oprime_status oprime_prev_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size);
+oprime_status oprime_next_prime_dec(oprime_engine* engine, const char* n, char* out, size_t size);
+
+/* Calls fn(p, context) for every prime p in [lo, hi], in increasing order, on the calling
+   thread, and stores how many there were in count (when it is not NULL). On a timeout fn
+   has seen every prime up to where oprime_last_error() says. */
+typedef void (*oprime_prime_fn)(uint64_t prime, void* context);
+oprime_status oprime_primes_in_range(oprime_engine* engine, uint64_t lo, uint64_t hi, oprime_prime_fn fn,
+                                     void* context, uint64_t* count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OPRIME_H */
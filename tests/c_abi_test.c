@@ -0,0 +1,103 @@
+/*
+ * The C ABI of oprime.h from C: status codes, the decimal forms and their buffers,
+ * answers past 64 bits, range callbacks and time limits, linked against liboprime.
+ * Built as C99, so the header is checked to compile without C++.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "oprime.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                             \
+        }                                                           \
+    } while (0)
+
+/* Sums the primes seen, and checks they come in increasing order */
+typedef struct {
+    uint64_t count, sum, last;
+    int ordered;
+} seen;
+
+static void collect(uint64_t p, void* context) {
+    seen* s = (seen*)context;
+    if (s->count && p <= s->last) s->ordered = 0;
+    s->count++;
+    s->sum += p;
+    s->last = p;
+}
+
+static void queries(oprime_engine* e) {
+    uint64_t v = 0;
+    CHECK(oprime_nth_prime(e, 1000000, &v) == OPRIME_OK && v == 15485863);
+    CHECK(oprime_nth_prime(e, 0, &v) == OPRIME_OK && v == 0);
+    CHECK(oprime_prev_prime(e, 1, &v) == OPRIME_OK && v == 0);
+    CHECK(oprime_prev_prime(e, UINT64_MAX, &v) == OPRIME_OK && v == 18446744073709551557u);
+    CHECK(oprime_next_prime(e, 1000000000000u, &v) == OPRIME_OK && v == 1000000000039u);
+    CHECK(oprime_count_primes(e, 1000000000000u, &v) == OPRIME_OK && v == 37607912018u);
+    CHECK(strcmp(oprime_last_error(e), "") == 0);
+
+    /* The next prime after 2^64 - 1 needs 65 bits: the uint64_t form refuses it and leaves
+       the output alone, the decimal one gives it */
+    v = 7;
+    CHECK(oprime_next_prime(e, UINT64_MAX, &v) == OPRIME_OVERFLOW && v == 7);
+    CHECK(strlen(oprime_last_error(e)) > 0);
+    char buf[1300];
+    CHECK(oprime_next_prime_dec(e, "18446744073709551615", buf, sizeof buf) == OPRIME_OK);
+    CHECK(strcmp(buf, "18446744073709551629") == 0 && strcmp(oprime_last_error(e), "") == 0);
+    CHECK(oprime_prev_prime_dec(e, "340282366920938463463374607431768211456", buf, sizeof buf) == OPRIME_OK);
+    CHECK(strcmp(buf, "340282366920938463463374607431768211297") == 0);
+
+    /* The answer and its NUL need 21 bytes */
+    CHECK(oprime_next_prime_dec(e, "18446744073709551615", buf, 20) == OPRIME_OVERFLOW);
+    CHECK(strlen(oprime_last_error(e)) > 0);
+    CHECK(oprime_next_prime_dec(e, "18446744073709551615", buf, 21) == OPRIME_OK);
+    CHECK(oprime_nth_prime_dec(e, "12x", buf, sizeof buf) == OPRIME_INVALID);
+    CHECK(oprime_nth_prime_dec(e, "", buf, sizeof buf) == OPRIME_INVALID);
+    CHECK(oprime_nth_prime_dec(e, "-5", buf, sizeof buf) == OPRIME_INVALID);
+}
+
+static void ranges(oprime_engine* e) {
+    seen s = {0, 0, 0, 1};
+    uint64_t count = 0;
+    CHECK(oprime_primes_in_range(e, 1000000, 2000000, collect, &s, &count) == OPRIME_OK);
+    CHECK(count == 70435 && s.count == count && s.sum == 105363426899u && s.last == 1999993 && s.ordered);
+
+    /* The top of the 64-bit range, and a count without one */
+    seen top = {0, 0, 0, 1};
+    CHECK(oprime_primes_in_range(e, 18446744073709551000u, UINT64_MAX, collect, &top, NULL) == OPRIME_OK);
+    CHECK(top.count == 13 && top.last == 18446744073709551557u && top.ordered);
+    CHECK(oprime_primes_in_range(e, 10, 1, collect, &s, &count) == OPRIME_OK && count == 0);
+    CHECK(oprime_primes_in_range(e, 0, 10, NULL, NULL, NULL) == OPRIME_INVALID);
+}
+
+static void timeouts(void) {
+    oprime_engine* e = oprime_create(1, 100);
+    CHECK(e != NULL);
+    seen s = {0, 0, 0, 1};
+    CHECK(oprime_primes_in_range(e, 0, UINT64_MAX, collect, &s, NULL) == OPRIME_TIMEOUT && s.ordered);
+    CHECK(strlen(oprime_last_error(e)) > 0);
+    char buf[64];
+    CHECK(oprime_nth_prime_dec(e, "100000000000000000000", buf, sizeof buf) == OPRIME_TIMEOUT);
+    CHECK(strlen(oprime_last_error(e)) > 0);
+    /* The limit is per query: the engine goes on answering */
+    uint64_t v = 0;
+    CHECK(oprime_nth_prime(e, 10, &v) == OPRIME_OK && v == 29);
+    oprime_destroy(e);
+}
+
+int main(void) {
+    oprime_engine* e = oprime_create(2, 0);
+    CHECK(e != NULL);
+    if (!e) return 1;
+    queries(e);
+    ranges(e);
+    oprime_destroy(e);
+    timeouts();
+    if (failures) printf("%d check(s) failed\n", failures);
+    return failures != 0;
+}
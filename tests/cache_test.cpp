@@ -0,0 +1,88 @@
+// PrimeCache through the engines: checkpoints and anchors written by one Engine and
+// picked up by the next, with the answers checked against known p_n, and caches in one
+// process saving to the same file at once.
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "OPrime.hpp"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            std::printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                             \
+        }                                                           \
+    } while (0)
+
+uint64_t nth(const std::string& dir, uint64_t n) {
+    oprime::Options options;
+    options.cache_dir = dir;
+    oprime::Engine engine(options);
+    uint64_t p = (uint64_t)engine.nth_prime(BigInt4096(n));
+    CHECK(engine.cache_saved());
+    return p;
+}
+
+// The counting path leaves pi(p_n - 1) = n - 1 behind, and a repeat sieves on from there
+void anchors(const std::string& dir) {
+    CHECK(nth(dir, 1000000000) == 22801763489);
+    PrimeCache::Anchor a = PrimeCache(dir).anchorBelow(1000000000);
+    CHECK(a.x == 22801763488 && a.count == 999999999);
+    CHECK(nth(dir, 1000000000) == 22801763489);
+    CHECK(nth(dir, 1000001000) == 22801787297);
+    CHECK(nth(dir, 999999000) == 22801739801);
+    // The sieve path below the counting threshold extends the checkpoint prefix
+    CHECK(nth(dir, 1000000) == 15485863);
+    CHECK(PrimeCache(dir).size() > 1);
+    CHECK(nth(dir, 999999) == 15485857);
+}
+
+// Threads of one process, as --batch --threads or several C ABI engines have: every save
+// must land, and the file must stay readable throughout
+void concurrentSaves(const std::string& dir) {
+    constexpr int THREADS = 4, SAVES = 200;
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < SAVES; ++i) {
+                PrimeCache cache(dir);
+                uint64_t x = (uint64_t)(i * THREADS + t + 1) * 1000;
+                cache.anchor(x, x / 10);
+                if (!cache.save()) ++failed;
+            }
+        });
+    for (auto& t : threads) t.join();
+    CHECK(failed == 0);
+    // Merges can drop a racing save's anchor, never corrupt the file
+    PrimeCache cache(dir);
+    PrimeCache::Anchor last = cache.anchorBelow(UINT64_MAX);
+    CHECK(last.x != 0 && last.count == last.x / 10);
+    size_t leftovers = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir))
+        leftovers += entry.path().filename() != "nth_prime.cache";
+    CHECK(leftovers == 0);
+}
+
+} // namespace
+
+int main() {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / ("oprime_cache_test." + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    anchors(dir.string());
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    concurrentSaves(dir.string());
+    fs::remove_all(dir);
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,85 @@
+// Engine dispatch of the bulk base-2 round: a mock GPU backend registered for Device::GPU
+// must see the wide candidates of a GPU Engine and none of a CPU one, and its verdicts
+// must decide the answers.
+#include <atomic>
+#include <cstdio>
+#include "OPrime.hpp"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            std::printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                             \
+        }                                                           \
+    } while (0)
+
+std::atomic<uint64_t> tested{0};
+
+// Counts candidates and answers as the CPU would
+struct MockGpu {
+    template <size_t Bits>
+    static void base2(const BigInt<Bits>* n, size_t count, bool* passed) {
+        tested += count;
+        BigInt<Bits>::isStrongProbablePrimeBatch(n, count, passed);
+    }
+};
+
+// Fails every candidate, so nothing the CPU would not confirm anyway gets through either
+struct RejectAll {
+    template <size_t Bits>
+    static void base2(const BigInt<Bits>*, size_t count, bool* passed) {
+        tested += count;
+        for (size_t i = 0; i < count; ++i) passed[i] = false;
+    }
+};
+
+oprime::Options on(oprime::Device device) {
+    oprime::Options options;
+    options.device = device;
+    return options;
+}
+
+uint64_t count(oprime::Engine& engine, const BigInt4096& lo, const BigInt4096& hi) {
+    return engine.primes_in_range(lo, hi, [](const auto&) {});
+}
+
+} // namespace
+
+int main() {
+    using oprime::Device;
+    const BigInt4096 wide = BigInt4096(1) << 300, lo = BigInt4096(1) << 100, hi = lo + BigInt4096(20000);
+
+    oprime::Engine cpu(on(Device::CPU));
+    const BigInt4096 next = cpu.next_prime(wide);
+    const uint64_t primes = count(cpu, lo, hi);
+    CHECK(next == wide + BigInt4096(157) && primes > 0);
+
+    // Nothing registered: GPU Engines run on the CPU
+    CHECK(!oprime::device_available(Device::GPU));
+    oprime::Engine early(on(Device::GPU));
+    CHECK(early.next_prime(wide) == next && tested == 0);
+
+    oprime::register_backend(Device::GPU, oprime::Backend::of<MockGpu>());
+    CHECK(oprime::device_available(Device::GPU));
+    oprime::Engine gpu(on(Device::GPU));
+    CHECK(gpu.next_prime(wide) == next && tested > 0);
+    uint64_t before = tested;
+    CHECK(count(gpu, lo, hi) == primes && tested > before);
+
+    // CPU Engines, and GPU ones made before the backend was, never reach it
+    before = tested;
+    CHECK(cpu.next_prime(wide + BigInt4096(1000)) == oprime::Engine().next_prime(wide + BigInt4096(1000)));
+    CHECK(count(cpu, lo, hi) == primes && count(early, lo, hi) == primes && tested == before);
+
+    oprime::register_backend(Device::GPU, oprime::Backend::of<RejectAll>());
+    oprime::Engine rejecting(on(Device::GPU));
+    CHECK(count(rejecting, lo, hi) == 0 && tested > before);
+    CHECK(count(gpu, lo, hi) == primes);
+
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,111 @@
+// GapReader on gap files written by PrimeWriter: lookups against the sieve, then
+// truncated and corrupted copies, which must be refused or read without leaving the map.
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "PrimeGaps.hpp"
+#include "PrimeWriter.hpp"
+#include "SegmentedSieve.hpp"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                 \
+    do {                                                            \
+        if (!(cond)) {                                              \
+            std::printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                             \
+        }                                                           \
+    } while (0)
+
+std::string read(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void write(const std::string& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+}
+
+// Every prime below 4 * 10^6: 283146 of them, so four full blocks and a partial one
+void lookups(const std::string& path, const std::vector<uint64_t>& primes) {
+    GapReader reader(path);
+    CHECK(reader.isOpen());
+    CHECK(reader.size() == primes.size() && reader.last() == primes.back());
+    for (uint64_t i : {0ul, 1ul, 2ul, 65535ul, 65536ul, 65537ul, 200000ul, (unsigned long)primes.size() - 1})
+        CHECK(reader.at(i) == primes[i]);
+    CHECK(reader.at(primes.size()) == 0 && reader.at(UINT64_MAX) == 0);
+    CHECK(reader.countUpTo(1000000) == 78498 && reader.countUpTo(1) == 0 && reader.countUpTo(UINT64_MAX) == primes.size());
+    std::vector<uint64_t> seen;
+    reader.forEach(0, UINT64_MAX, [&](uint64_t p) { seen.push_back(p); });
+    CHECK(seen == primes);
+}
+
+void damaged(const std::string& path, const std::string& dir) {
+    std::string file = read(path);
+    GapFormat::Header header;
+    std::memcpy(&header, file.data(), sizeof header);
+    std::string copy = dir + "/damaged.gaps";
+
+    // Cut anywhere: inside the header, inside the gaps, inside the index
+    for (size_t keep : {(size_t)0, sizeof header - 1, sizeof header + 100, (size_t)header.indexOffset,
+                        file.size() - 1}) {
+        write(copy, file.substr(0, keep));
+        CHECK(!GapReader(copy).isOpen());
+    }
+
+    // Index entries pointing past the gaps, into the header, or out of order
+    auto entry = [&](uint64_t b) { return header.indexOffset + b * sizeof(GapFormat::BlockEntry); };
+    struct { uint64_t block; size_t field; uint64_t value; } edits[] = {
+        {2, 8, file.size() + 4096}, {0, 8, 10}, {3, 8, 100}, {2, 0, 1}, {4, 0, header.lastPrime + 2},
+    };
+    for (const auto& e : edits) {
+        std::string bad = file;
+        std::memcpy(&bad[entry(e.block) + e.field], &e.value, sizeof e.value);
+        write(copy, bad);
+        CHECK(!GapReader(copy).isOpen());
+    }
+
+    // Gaps that never end (every byte a continuation) in the last block: the decoder stops
+    // at the index instead of running past the map
+    GapFormat::BlockEntry last;
+    std::memcpy(&last, &file[entry(header.blocks - 1)], sizeof last);
+    std::string runaway = file;
+    for (uint64_t at = last.offset; at < header.indexOffset; ++at) runaway[at] = (char)0xff;
+    write(copy, runaway);
+    GapReader reader(copy);
+    CHECK(reader.isOpen());
+    uint64_t seen = 0;
+    reader.forEach(0, UINT64_MAX, [&](uint64_t) { ++seen; });
+    CHECK(seen > 0 && reader.at(reader.size() - 1) != 0);
+}
+
+} // namespace
+
+int main() {
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / ("oprime_gaps_test." + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string path = (dir / "primes.gaps").string();
+
+    std::vector<uint64_t> primes;
+    const uint64_t limit = 4000000;
+    SegmentedSieve sieve(0, limit, SegmentedSieve::sievingPrimes(limit));
+    while (sieve.nextSegment([&](uint64_t p) { primes.push_back(p); })) {}
+    {
+        PrimeWriter writer(path, PrimeWriter::Format::Gaps);
+        for (uint64_t p : primes) writer.put(p);
+        CHECK(writer.close());
+    }
+    CHECK(primes.size() == 283146);
+    lookups(path, primes);
+    damaged(path, dir.string());
+    fs::remove_all(dir);
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures != 0;
+}
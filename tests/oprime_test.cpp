@@ -0,0 +1,158 @@
+// Known-answer checks for BigInt arithmetic and isPrime, at every word-kernel level the CPU
+// has. The expected values come from Python's integers. The CLI answers are checked by
+// the add_test entries in CMakeLists.txt.
+#include <cstdio>
+#include <string>
+#include "BigInt4096.hpp"
+#include "WordKernels.hpp"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                          \
+    do {                                                                                     \
+        if (!(cond)) {                                                                       \
+            std::printf("%s:%d: %s failed (%s kernels)\n", __FILE__, __LINE__, #cond, level()); \
+            ++failures;                                                                      \
+        }                                                                                    \
+    } while (0)
+
+const char* level() {
+    switch (WordKernels::level()) {
+    case WordKernels::Level::AVX512: return "AVX-512";
+    case WordKernels::Level::AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+template <size_t Bits>
+std::string str(const BigInt<Bits>& x) {
+    char buf[1300];
+    auto r = x.toChars(buf, buf + sizeof buf);
+    return std::string(buf, r.ptr);
+}
+
+// 2^exp in a Bits-bit BigInt
+template <size_t Bits>
+BigInt<Bits> power2(size_t exp) { return BigInt<Bits>(1) << exp; }
+
+// A = 3^200, B = 7^150
+const char* A = "265613988875874769338781322035779626829233452653394495974574961739092490901302182994384699044001";
+const char* B = "581709293382434316543252400339169116491985964971934053262756720760765685903435699556658970789421"
+                "0757866827613621721127496191249";
+
+void arithmetic() {
+    using Int = BigInt4096;
+    Int a(A), b(B);
+    CHECK(str(a) == A && str(b) == B);
+    CHECK(str(a * b) == "154510125781474881128672773657253627070648332729718569779388526327735485965270630412651948422694"
+                        "761081458828826259956358416276819119792018598553105810827903210075892055185403474025096561434576"
+                        "0459124467215428114258962147249");
+    CHECK(str(b - a) == "581709293382434316543252400339142555093098377495000175130553142798082762558170360107061513293247"
+                        "1665375926311438726742797147248");
+    CHECK(str(b / a) == "21900551843836636987733069242784");
+    CHECK(str(b % a) == "27842578356254637262799863190063704582478912033115668681951761811665728650043504552585728452465");
+    CHECK(str(a << 300) == "541065251157864887211041106500951546849198083650605175631231999311595717627039750725653834516531"
+                           "293192786380424503345814918785318111465779185310398101365179531660546590048939925491941376");
+    CHECK(str(b >> 200) == "3619985819992697889262630208667249192167910443149826150767814453746");
+
+    // Products and quotients that fill the width
+    Int big = (a * b) * (a * b);
+    Int q, r;
+    Int::divmod(big, b, q, r);
+    CHECK(r == Int(0) && q == a * a * b);
+    Int ab = a * b % Int(1000000007);
+    CHECK(Int(big.modSmall(1000000007)) == ab * ab % Int(1000000007));
+    CHECK(~Int(0) + Int(1) == Int(0));
+
+    // Odd moduli go through Montgomery
+    CHECK(str(Int::modExp(a, b, power2<4096>(127) - Int(1))) == "115072901150511884648336036169057192562");
+    CHECK(str(Int::modExp(a, b, Int("10000000000000000000000000000000000000001"))) ==
+          "518219238397850063520529403066822712388");
+}
+
+// base^exp mod m by square-and-multiply in twice the width, where no product can overflow
+template <size_t Bits>
+BigInt<Bits> wideModExp(const BigInt<Bits>& base, BigInt<Bits> exp, const BigInt<Bits>& mod) {
+    using Wide = BigInt<2 * Bits>;
+    Wide m(mod), b = Wide(base) % m, r(1);
+    for (; exp != BigInt<Bits>(0); exp >>= 1) {
+        if (uint64_t(exp) & 1) r = r * b % m;
+        b = b * b % m;
+    }
+    return BigInt<Bits>(r);
+}
+
+// Even moduli skip Montgomery, and past Bits / 2 bits their products no longer fit
+template <size_t Bits>
+void evenModulus() {
+    using Int = BigInt<Bits>;
+    size_t bits = Bits * 3 / 4;
+    Int mod = power2<Bits>(bits) + Int(6), exp = Int(282475249) * Int(282475249) + Int(2);
+    Int base = Int(1);
+    for (size_t i = 0; i < bits * 63 / 100; ++i) base = base * Int(3);
+    CHECK(Int::modExp(base, exp, mod) == wideModExp(base, exp, mod));
+    CHECK(Int::modMul(base, mod - Int(1), mod) == mod - base);
+    // (3^60)^(7^20 + 2) mod 2^96 + 6, from Python
+    if (Bits == 128) CHECK(str(Int::modExp(base, exp, mod)) == "50325782790252477763521700589");
+}
+
+template <size_t Bits>
+void primes() {
+    using Int = BigInt<Bits>;
+    // The largest prime below 2^N
+    static const struct { size_t bits; uint64_t offset; } below[] = {
+        {64, 59}, {128, 159}, {256, 189}, {512, 569}, {1024, 105}, {2048, 1557}, {4096, 2549},
+    };
+    for (const auto& p : below) {
+        if (p.bits > Bits) break;
+        Int n = p.bits == Bits ? Int(0) - Int(p.offset) : power2<Bits>(p.bits) - Int(p.offset);
+        CHECK(Int::isPrime(n));
+        CHECK(!Int::isPrime(n + Int(2)));
+    }
+    // Mersenne primes, and 2^N - 1 for composite N
+    CHECK(Int::isPrime(power2<Bits>(127) - Int(1)));
+    CHECK(!Int::isPrime(power2<Bits>(125) - Int(1)));
+    if (Bits >= 1024) CHECK(Int::isPrime(power2<Bits>(607) - Int(1)));
+
+    // The smallest strong pseudoprimes to the first k prime bases, k = 1, 2, 3, 4, 5, 6, 7, 9, 12, 13
+    static const char* pseudoprimes[] = {
+        "2047", "1373653", "25326001", "3215031751", "2152302898747", "3474749660383", "341550071728321",
+        "3825123056546413051", "318665857834031151167461", "3317044064679887385961981",
+    };
+    for (const char* s : pseudoprimes) {
+        Int n(s);
+        CHECK(Int::isStrongProbablePrime(n, 2));
+        // With and without trial division in front of the exponentiations
+        CHECK(!Int::isPrime(n) && !Int::isPrime(n, PrimalityTest::Auto, 5, 0));
+        CHECK(!Int::isPrime(n, PrimalityTest::BailliePSW, 5, 0));
+    }
+    // 318665857834031151167461 fools exactly the first 12 bases
+    CHECK(Int::isPrime(Int("318665857834031151167461"), PrimalityTest::FixedBases, 12, 0));
+    CHECK(!Int::isPrime(Int("318665857834031151167461"), PrimalityTest::FixedBases, 13, 0));
+    // Carmichael numbers and strong Lucas pseudoprimes
+    for (uint64_t n : {561, 41041, 825265, 5459, 5777, 10877})
+        CHECK(!Int::isPrime(Int(n), PrimalityTest::Auto, 5, 0) && !Int::isPrime(Int(n), PrimalityTest::BailliePSW, 5, 0));
+}
+
+} // namespace
+
+int main() {
+    for (auto want : {WordKernels::Level::Scalar, WordKernels::Level::AVX2, WordKernels::Level::AVX512}) {
+        WordKernels::select(want);
+        // select() clamps to what the CPU has: run each level once
+        if (WordKernels::level() != want) continue;
+        arithmetic();
+        evenModulus<128>();
+        evenModulus<256>();
+        evenModulus<1024>();
+        evenModulus<4096>();
+        primes<128>();
+        primes<256>();
+        primes<1024>();
+        primes<4096>();
+    }
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures != 0;
+}